@@ -0,0 +1,54 @@
+/* pic.c - 8259A programmable interrupt controller */
+#include "pic.h"
+#include "io.h"
+
+#define PIC1_CMD  0x20
+#define PIC1_DATA 0x21
+#define PIC2_CMD  0xA0
+#define PIC2_DATA 0xA1
+
+#define PIC_EOI       0x20
+#define PIC_READ_IRR  0x0A    /* OCW3: next command-port read returns IRR */
+#define ICW1_INIT     0x11    /* edge triggered, cascade, ICW4 needed */
+#define ICW4_8086     0x01
+
+/* Small delay for old PICs: write to an unused port */
+static void io_wait(void) {
+    outb(0x80, 0);
+}
+
+void pic_init(uint8_t vector_base) {
+    outb(PIC1_CMD, ICW1_INIT);  io_wait();
+    outb(PIC2_CMD, ICW1_INIT);  io_wait();
+    outb(PIC1_DATA, vector_base);      io_wait();  /* ICW2: vector offsets */
+    outb(PIC2_DATA, vector_base + 8);  io_wait();
+    outb(PIC1_DATA, 0x04);      io_wait();         /* ICW3: slave on IRQ2 */
+    outb(PIC2_DATA, 0x02);      io_wait();
+    outb(PIC1_DATA, ICW4_8086); io_wait();
+    outb(PIC2_DATA, ICW4_8086); io_wait();
+
+    /* Mask everything except the cascade line */
+    outb(PIC1_DATA, 0xFB);
+    outb(PIC2_DATA, 0xFF);
+}
+
+void pic_mask(int irq) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    outb(port, inb(port) | (1 << (irq & 7)));
+}
+
+void pic_unmask(int irq) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    outb(port, inb(port) & ~(1 << (irq & 7)));
+}
+
+void pic_eoi(int irq) {
+    if (irq >= 8) outb(PIC2_CMD, PIC_EOI);
+    outb(PIC1_CMD, PIC_EOI);
+}
+
+int pic_pending(int irq) {
+    uint16_t port = irq < 8 ? PIC1_CMD : PIC2_CMD;
+    outb(port, PIC_READ_IRR);
+    return (inb(port) >> (irq & 7)) & 1;
+}
@@ -0,0 +1,16 @@
+/* pic.h - 8259A programmable interrupt controller */
+#ifndef PIC_H
+#define PIC_H
+
+#include "types.h"
+
+/* Remap both PICs to vector_base..vector_base+15 with all lines masked */
+void pic_init(uint8_t vector_base);
+void pic_mask(int irq);
+void pic_unmask(int irq);
+void pic_eoi(int irq);
+
+/* Has irq been raised but not yet delivered (its IRR bit is set)? */
+int pic_pending(int irq);
+
+#endif
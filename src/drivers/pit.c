@@ -0,0 +1,55 @@
+/* pit.c - 8253/8254 programmable interval timer */
+#include "pit.h"
+#include "io.h"
+
+#define PIT_CH0  0x40
+#define PIT_CH2  0x42
+#define PIT_CMD  0x43
+#define PIT_GATE 0x61           /* bit 0: channel 2 gate, bit 1: speaker, bit 5: OUT2 */
+
+#define PIT_MODE_RATE 0x34      /* channel 0, lo/hi byte, mode 2, binary */
+#define PIT_MODE_ONESHOT 0x30   /* channel 0, lo/hi byte, mode 0, binary */
+#define PIT_LATCH 0x00          /* counter latch command for channel 0 */
+#define PIT_CH2_ONESHOT 0xB0    /* channel 2, lo/hi byte, mode 0, binary */
+
+static uint32_t pit_div = 0;
+
+void pit_init(uint32_t hz) {
+    uint32_t divisor = PIT_BASE_HZ / hz;
+    if (divisor > 0xFFFF) divisor = 0xFFFF;
+    if (divisor < 1) divisor = 1;
+    pit_div = divisor;
+
+    outb(PIT_CMD, PIT_MODE_RATE);
+    outb(PIT_CH0, divisor & 0xFF);
+    outb(PIT_CH0, (divisor >> 8) & 0xFF);
+}
+
+uint32_t pit_divisor(void) {
+    return pit_div;
+}
+
+void pit_oneshot(uint16_t count) {
+    outb(PIT_CMD, PIT_MODE_ONESHOT);
+    outb(PIT_CH0, count & 0xFF);
+    outb(PIT_CH0, (count >> 8) & 0xFF);
+}
+
+uint16_t pit_read(void) {
+    uint8_t lo, hi;
+    outb(PIT_CMD, PIT_LATCH);
+    lo = inb(PIT_CH0);
+    hi = inb(PIT_CH0);
+    return ((uint16_t)hi << 8) | lo;
+}
+
+void pit_wait(uint16_t count) {
+    /* Gate channel 2 on with the speaker off; OUT2 goes high at zero */
+    uint8_t gate = inb(PIT_GATE);
+    outb(PIT_GATE, (gate & ~0x02) | 0x01);
+    outb(PIT_CMD, PIT_CH2_ONESHOT);
+    outb(PIT_CH2, count & 0xFF);
+    outb(PIT_CH2, (count >> 8) & 0xFF);
+    while (!(inb(PIT_GATE) & 0x20));
+    outb(PIT_GATE, gate);
+}
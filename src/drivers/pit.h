@@ -0,0 +1,25 @@
+/* pit.h - 8253/8254 programmable interval timer */
+#ifndef PIT_H
+#define PIT_H
+
+#include "types.h"
+
+#define PIT_BASE_HZ 1193182
+
+/* Program channel 0 as a periodic rate generator at hz (IRQ0) */
+void pit_init(uint32_t hz);
+
+/* Reload value of the periodic mode, in PIT input clocks per tick */
+uint32_t pit_divisor(void);
+
+/* Fire IRQ0 once after count input clocks (1..65535), then stop */
+void pit_oneshot(uint16_t count);
+
+/* Latch and read the current channel 0 counter */
+uint16_t pit_read(void);
+
+/* Busy-wait count input clocks on channel 2, leaving channel 0 and IRQ0
+   alone (used to calibrate the TSC) */
+void pit_wait(uint16_t count);
+
+#endif
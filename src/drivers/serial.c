@@ -1,6 +1,8 @@
 /* serial.c - Serial port driver (COM1) */
 #include "serial.h"
 #include "io.h"
+#include "scheduler.h"
+#include "string.h"
 
 #define COM1 0x3F8   /* I/O port base address for COM1 */
 
@@ -15,48 +17,297 @@ QEMU (-serial stdio)
     ↓
 Emulated COM1 port (0x3F8)
     ↓
-serial_getc() reads from COM1
+IRQ4 handler moves bytes into the RX ring
+    ↓
+serial_getc() takes them from the ring (blocking while it is empty)
     ↓
 Your OS receives the character
 
 If you want real keyboard input, you'd need to add a keyboard driver.
 */
 
+/* 16550 registers (offsets from COM1) and bits */
+#define UART_DATA   0
+#define UART_IER    1       /* divisor high byte while DLAB is set */
+#define UART_IIR    2
+#define UART_LCR    3
+#define UART_LSR    5
+
+#define LCR_8N1     0x03
+#define LCR_DLAB    0x80
+
+#define IER_RDA     0x01    /* received data available */
+#define IER_THRE    0x02    /* transmit holding register empty */
+
+#define IIR_NONE    0x01    /* no interrupt pending */
+#define IIR_ID_MASK 0x0E
+#define IIR_LSR     0x06    /* line status */
+#define IIR_RDA     0x04    /* received data */
+#define IIR_TIMEOUT 0x0C    /* RX FIFO timeout */
+#define IIR_THRE    0x02    /* transmitter empty */
+
+#define LSR_DR      0x01    /* data ready */
+#define LSR_THRE    0x20    /* transmit holding register empty */
+#define LSR_TEMT    0x40    /* transmitter (FIFO and shift register) empty */
+
+#define UART_FIFO_DEPTH 16
+
+/* Single-producer/single-consumer rings with free-running indices. The
+   producer only writes head, the consumer only writes tail, so neither
+   side needs a lock. RX: IRQ4 produces, the reading task consumes. TX:
+   tasks produce (serialized against each other by irq_save, which they
+   need anyway to arm the THRE interrupt), IRQ4 consumes. */
+typedef struct {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint32_t size;          /* power of two */
+    uint8_t *buf;
+} ring_t;
+
+static uint8_t rx_buf[SERIAL_RX_RING];
+static uint8_t tx_buf[SERIAL_TX_RING];
+static ring_t rx_ring = { 0, 0, SERIAL_RX_RING, rx_buf };
+static ring_t tx_ring = { 0, 0, SERIAL_TX_RING, tx_buf };
+
+static wait_queue_t rx_wait = WAIT_QUEUE_INIT;
+static wait_queue_t tx_wait = WAIT_QUEUE_INIT;
+
+static int irq_mode = 0;        /* IRQ4 handler installed */
+static uint8_t ier = 0;         /* shadow of the interrupt-enable register */
+static uint32_t rx_dropped = 0;
+static uint32_t baud_rate = SERIAL_DEFAULT_BAUD;
+
+#define barrier() __asm__ volatile ("" : : : "memory")
+
+static uint32_t ring_count(const ring_t *r) {
+    return r->head - r->tail;
+}
+
+static void set_ier(uint8_t val) {
+    ier = val;
+    outb(COM1 + UART_IER, ier);
+}
+
 void serial_init(void) {
     outb(COM1 + 1, 0x00);    /* Disable interrupts */
-    outb(COM1 + 3, 0x80);    /* Enable DLAB (set baud rate divisor) */
-    outb(COM1 + 0, 0x03);    /* Divisor low byte (38400 baud) */
-    outb(COM1 + 1, 0x00);    /* Divisor high byte */
-    outb(COM1 + 3, 0x03);    /* 8 bits, no parity, 1 stop bit */
+    serial_set_baud(SERIAL_DEFAULT_BAUD);
     outb(COM1 + 2, 0xC7);    /* Enable FIFO, clear, 14-byte threshold */
     outb(COM1 + 4, 0x0B);    /* IRQs enabled, RTS/DSR set */
 }
 
 static int is_transmit_empty(void) {
-    return inb(COM1 + 5) & 0x20;
+    return inb(COM1 + UART_LSR) & LSR_THRE;
 }
 
-void serial_putc(char c) {
-    if (c == '\n') {
-        serial_putc('\r');  /* Add carriage return */
+static int serial_received(void) {
+    return inb(COM1 + UART_LSR) & LSR_DR;
+}
+
+/* Move up to one FIFO's worth of queued bytes into the UART. Only called
+   once THRE says the FIFO is empty, so all 16 bytes fit. */
+static void tx_burst(void) {
+    int n = 0;
+    while (n < UART_FIFO_DEPTH && ring_count(&tx_ring) > 0) {
+        uint32_t t = tx_ring.tail;
+        outb(COM1 + UART_DATA, tx_ring.buf[t & (tx_ring.size - 1)]);
+        barrier();
+        tx_ring.tail = t + 1;
+        n++;
+    }
+}
+
+/* Drain the TX ring by polling. Used before IRQ4 is set up and whenever
+   the caller runs with interrupts disabled (IRQ handlers, panics), where
+   the THRE interrupt could not be serviced. Called with interrupts off. */
+static void tx_drain_polled(void) {
+    while (ring_count(&tx_ring) > 0) {
+        while (!is_transmit_empty());
+        tx_burst();
+    }
+}
+
+static void rx_push(uint8_t c) {
+    uint32_t h = rx_ring.head;
+    if (h - rx_ring.tail == rx_ring.size) {
+        rx_dropped++;
+        return;
+    }
+    rx_ring.buf[h & (rx_ring.size - 1)] = c;
+    barrier();
+    rx_ring.head = h + 1;
+}
+
+void serial_irq(void) {
+    uint8_t iir;
+    int woke_rx = 0, woke_tx = 0;
+
+    while (!((iir = inb(COM1 + UART_IIR)) & IIR_NONE)) {
+        switch (iir & IIR_ID_MASK) {
+            case IIR_RDA:
+            case IIR_TIMEOUT:
+                while (serial_received()) {
+                    rx_push(inb(COM1 + UART_DATA));
+                }
+                woke_rx = 1;
+                break;
+            case IIR_THRE:
+                tx_burst();
+                if (ring_count(&tx_ring) == 0) {
+                    set_ier(ier & ~IER_THRE);
+                }
+                woke_tx = 1;
+                break;
+            case IIR_LSR:
+                inb(COM1 + UART_LSR);
+                break;
+            default:
+                inb(COM1 + 6);      /* modem status: read to clear */
+                break;
+        }
     }
-    while (!is_transmit_empty());
-    outb(COM1, c);
+    if (woke_rx) sched_wake_all(&rx_wait);
+    if (woke_tx) sched_wake_all(&tx_wait);
+}
+
+void serial_enable_irq(void) {
+    uint32_t flags = irq_save();
+    irq_mode = 1;
+    set_ier(IER_RDA | (ring_count(&tx_ring) ? IER_THRE : 0));
+    irq_restore(flags);
+}
+
+/* Start the transmitter after queueing, or flush synchronously if no
+   interrupt will come to do it */
+static void tx_kick(uint32_t flags) {
+    if (irq_mode && (flags & EFLAGS_IF)) {
+        if (!(ier & IER_THRE)) {
+            /* Enabling THRE while the FIFO is empty raises IRQ4 at once */
+            set_ier(ier | IER_THRE);
+        }
+    } else {
+        tx_drain_polled();
+    }
+}
+
+/* Make room in a full TX ring; called with interrupts disabled */
+static void tx_wait_space(uint32_t flags) {
+    if (irq_mode && (flags & EFLAGS_IF)) {
+        tx_kick(flags);     /* a long write may not have armed THRE yet */
+        sched_wait(&tx_wait);
+    } else {
+        while (!is_transmit_empty());
+        tx_burst();
+    }
+}
+
+/* Copy buf into the TX ring, turning \n into \r\n on the way. The head
+   index is published once per run of copied bytes rather than per byte.
+   Called with interrupts disabled, flags = caller's EFLAGS. */
+static void tx_write(const char *buf, size_t len, uint32_t flags) {
+    uint32_t mask = tx_ring.size - 1;
+
+    while (len > 0) {
+        uint32_t h = tx_ring.head;
+        uint32_t room = tx_ring.size - (h - tx_ring.tail);
+        if (room < 2) {
+            tx_wait_space(flags);
+            continue;
+        }
+        /* keep two free slots per byte so an LF always fits with its CR */
+        while (len > 0 && room >= 2) {
+            char c = *buf++;
+            len--;
+            if (c == '\n') {
+                tx_ring.buf[h++ & mask] = '\r';
+                room--;
+            }
+            tx_ring.buf[h++ & mask] = (uint8_t)c;
+            room--;
+        }
+        barrier();
+        tx_ring.head = h;
+    }
+}
+
+void serial_write(const char *buf, size_t len) {
+    uint32_t flags = irq_save();
+    tx_write(buf, len, flags);
+    tx_kick(flags);
+    irq_restore(flags);
+}
+
+void serial_putc(char c) {
+    serial_write(&c, 1);
 }
 
 void serial_puts(const char* str) {
-    while (*str) {
-        serial_putc(*str++);
+    serial_write(str, strlen(str));
+}
+
+void serial_flush(void) {
+    uint32_t flags = irq_save();
+    if (irq_mode && (flags & EFLAGS_IF)) {
+        while (ring_count(&tx_ring) > 0) {
+            tx_kick(flags);
+            sched_wait(&tx_wait);
+        }
+    } else {
+        tx_drain_polled();
     }
+    irq_restore(flags);
 }
 
-static int serial_received(void) {
-    return inb(COM1 + 5) & 0x01;
+int serial_set_baud(uint32_t baud) {
+    if (baud == 0 || baud > SERIAL_MAX_BAUD || SERIAL_MAX_BAUD % baud != 0) {
+        return -1;
+    }
+    uint16_t divisor = SERIAL_MAX_BAUD / baud;
+
+    /* Let queued output leave at the old rate before switching */
+    uint32_t flags = irq_save();
+    tx_drain_polled();
+    while (!(inb(COM1 + UART_LSR) & LSR_TEMT));
+
+    outb(COM1 + UART_LCR, LCR_DLAB);                 /* divisor latch access */
+    outb(COM1 + UART_DATA, divisor & 0xFF);          /* divisor low byte */
+    outb(COM1 + UART_IER, divisor >> 8);             /* divisor high byte */
+    outb(COM1 + UART_LCR, LCR_8N1);                  /* 8 bits, no parity, 1 stop bit */
+    outb(COM1 + UART_IER, ier);
+    baud_rate = baud;
+    irq_restore(flags);
+    return 0;
+}
+
+uint32_t serial_get_baud(void) {
+    return baud_rate;
 }
 
 char serial_getc(void) {
-    while (!serial_received());
-    return inb(COM1);
+    uint32_t flags = irq_save();
+    char c;
+
+    if (!irq_mode || !(flags & EFLAGS_IF)) {
+        /* No RX interrupt can arrive: poll the UART behind the ring */
+        while (ring_count(&rx_ring) == 0 && !serial_received());
+        if (ring_count(&rx_ring) == 0) {
+            c = inb(COM1 + UART_DATA);
+            irq_restore(flags);
+            return c;
+        }
+    }
+    while (ring_count(&rx_ring) == 0) {
+        sched_wait(&rx_wait);
+    }
+    uint32_t t = rx_ring.tail;
+    c = rx_ring.buf[t & (rx_ring.size - 1)];
+    barrier();
+    rx_ring.tail = t + 1;
+    irq_restore(flags);
+    return c;
+}
+
+uint32_t serial_rx_dropped(void) {
+    return rx_dropped;
 }
 
 void serial_clear(void) {
@@ -4,10 +4,38 @@
 
 #include "types.h"
 
+/* Ring sizes in bytes (powers of two) */
+#define SERIAL_RX_RING 256
+#define SERIAL_TX_RING 4096
+
+/* Line rate: the divisor is SERIAL_MAX_BAUD / baud */
+#define SERIAL_MAX_BAUD     115200
+#define SERIAL_DEFAULT_BAUD 38400
+
 void serial_init(void);
 void serial_putc(char c);
 void serial_puts(const char* str);
+
+/* Queue len bytes for output in one batch, translating \n to \r\n */
+void serial_write(const char* buf, size_t len);
+
+/* Change the line rate; baud must divide 115200. Returns -1 if not. */
+int serial_set_baud(uint32_t baud);
+uint32_t serial_get_baud(void);
+
+/* Block until a byte arrives (polls until serial_enable_irq()) */
 char serial_getc(void);
+
+/* IRQ4 handler; register it, then call serial_enable_irq() */
+void serial_irq(void);
+void serial_enable_irq(void);
+
+/* Wait until everything queued has been handed to the UART */
+void serial_flush(void);
+
+/* Received bytes lost because the RX ring was full */
+uint32_t serial_rx_dropped(void);
+
 void serial_clear(void);
 
-#endif
\ No newline at end of file
+#endif
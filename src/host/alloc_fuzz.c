@@ -0,0 +1,160 @@
+/* alloc_fuzz.c - Randomized allocation-trace fuzzer for the kernel heap
+ *
+ * Usage: alloc_fuzz [seed] [ops]
+ *
+ * Replays a random malloc/free/realloc trace against memory.c and runs
+ * mem_check() after every operation. Each live payload is filled with a
+ * pattern derived from its slot, so overlapping blocks or a realloc that
+ * loses data show up when the block is next touched. Every few thousand
+ * operations the whole live set is freed and the heap must come back with
+ * no allocated blocks. Now and then a frame is taken from the PMM shim
+ * right behind the heap, so growth has to open new regions.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "memory.h"
+#include "pmm.h"
+#include "host.h"
+
+#define FUZZ_SLOTS      512
+#define FUZZ_FRAMES     8192        /* 32 MB arena */
+#define FUZZ_DRAIN      5000        /* ops between free-everything rounds */
+#define FUZZ_STEAL      1000        /* 1 in N ops takes a frame from the PMM */
+
+typedef struct {
+    uint8_t *ptr;
+    uint32_t size;
+    uint8_t tag;
+} slot_t;
+
+static slot_t slots[FUZZ_SLOTS];
+static uint32_t rng;
+static uint32_t op;
+
+static uint32_t n_malloc, n_free, n_realloc, n_oom, n_drain, n_steal;
+
+static void fail(const char *what, int s) {
+    fprintf(stderr, "alloc_fuzz: %s (op %u, slot %d)\n", what, op, s);
+    exit(1);
+}
+
+/* Mostly size-class requests, some first-fit, a few that force growth */
+static uint32_t rand_size(void) {
+    uint32_t r = host_rand(&rng) % 100;
+    if (r < 60) return 1 + host_rand(&rng) % MEM_CLASS_MAX;
+    if (r < 95) return MEM_CLASS_MAX + 1 + host_rand(&rng) % 16384;
+    return 1 + host_rand(&rng) % (128 * 1024);
+}
+
+static uint8_t pattern(const slot_t *sl, uint32_t i) {
+    return (uint8_t)(sl->tag ^ (i * 31));
+}
+
+static void fill(slot_t *sl, uint32_t from) {
+    uint32_t i;
+    for (i = from; i < sl->size; i++) sl->ptr[i] = pattern(sl, i);
+}
+
+static void verify(const slot_t *sl, uint32_t len, int s) {
+    uint32_t i;
+    for (i = 0; i < len; i++) {
+        if (sl->ptr[i] != pattern(sl, i)) fail("payload corrupted", s);
+    }
+}
+
+static void check_new(slot_t *sl, int s) {
+    if ((uintptr_t)sl->ptr % 8) fail("misaligned payload", s);
+    if (mem_block_size(sl->ptr) < sl->size) fail("block smaller than request", s);
+}
+
+static void do_malloc(int s) {
+    slot_t *sl = &slots[s];
+    sl->size = rand_size();
+    sl->ptr = kmalloc(sl->size);
+    n_malloc++;
+    if (!sl->ptr) {
+        n_oom++;
+        return;
+    }
+    sl->tag = (uint8_t)host_rand(&rng);
+    check_new(sl, s);
+    fill(sl, 0);
+}
+
+static void do_free(int s) {
+    slot_t *sl = &slots[s];
+    verify(sl, sl->size, s);
+    kfree(sl->ptr);
+    sl->ptr = NULL;
+    n_free++;
+}
+
+static void do_realloc(int s) {
+    slot_t *sl = &slots[s];
+    uint32_t size = rand_size();
+    uint8_t *p;
+
+    verify(sl, sl->size, s);
+    p = krealloc(sl->ptr, size);
+    n_realloc++;
+    if (!p) {
+        /* the old block must be untouched */
+        n_oom++;
+        verify(sl, sl->size, s);
+        return;
+    }
+    sl->ptr = p;
+    verify(sl, size < sl->size ? size : sl->size, s);
+    if (size > sl->size) {
+        uint32_t old = sl->size;
+        sl->size = size;
+        fill(sl, old);
+    } else {
+        sl->size = size;
+    }
+    check_new(sl, s);
+}
+
+static void drain(void) {
+    mem_info_t mi;
+    int s;
+
+    for (s = 0; s < FUZZ_SLOTS; s++) {
+        if (slots[s].ptr) do_free(s);
+    }
+    mem_info(&mi);
+    if (mi.alloc_blocks) fail("blocks still allocated after freeing all", -1);
+    if (mi.used != mi.cached) fail("used bytes leaked after freeing all", -1);
+    n_drain++;
+}
+
+int main(int argc, char **argv) {
+    uint32_t seed = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 1;
+    uint32_t ops = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 200000;
+    mem_info_t mi;
+
+    rng = seed ? seed : 1;
+    host_heap_init(FUZZ_FRAMES);
+    if (mem_check()) fail("fresh heap inconsistent", -1);
+
+    for (op = 0; op < ops; op++) {
+        int s = host_rand(&rng) % FUZZ_SLOTS;
+        if (!slots[s].ptr) do_malloc(s);
+        else if (host_rand(&rng) & 1) do_free(s);
+        else do_realloc(s);
+        if (host_rand(&rng) % FUZZ_STEAL == 0 && pmm_alloc()) n_steal++;
+
+        if (mem_check()) fail("heap invariant broken", s);
+        if ((op + 1) % FUZZ_DRAIN == 0) {
+            drain();
+            if (mem_check()) fail("heap invariant broken after drain", -1);
+        }
+    }
+    drain();
+
+    mem_info(&mi);
+    printf("alloc_fuzz: seed=%u ops=%u malloc=%u free=%u realloc=%u oom=%u "
+           "drains=%u stolen=%u heap=%u regions=%u OK\n", seed, ops, n_malloc,
+           n_free, n_realloc, n_oom, n_drain, n_steal, mi.heap_size, mi.regions);
+    return 0;
+}
@@ -0,0 +1,22 @@
+/* host.h - Helpers for the host build of the kernel modules (make host) */
+#ifndef HOST_H
+#define HOST_H
+
+#include "types.h"
+
+/* Reserve a frame arena for the pmm_* shim */
+void host_pmm_init(uint32_t frames);
+
+/* Map the arena and lay out the kernel heap in it, as kernel_main does */
+void host_heap_init(uint32_t frames);
+
+/* xorshift32; never returns 0 for a non-zero state */
+static inline uint32_t host_rand(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+#endif
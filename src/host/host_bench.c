@@ -0,0 +1,112 @@
+/* host_bench.c - High-iteration benchmarks of the heap and ready queues
+ *
+ * Usage: host_bench [iterations]
+ *
+ * Output follows the kernel suite: one "BENCH <test> key=value ..." line
+ * per result, with wall-clock ns and TSC cycles per operation.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "io.h"
+#include "memory.h"
+#include "runqueue.h"
+#include "host.h"
+
+#define BENCH_FRAMES    8192
+#define BENCH_LIVE      1024
+#define BENCH_RQ_TASKS  64
+
+typedef struct {
+    struct timespec ts;
+    uint64_t tsc;
+} stamp_t;
+
+static void stamp(stamp_t *s) {
+    clock_gettime(CLOCK_MONOTONIC, &s->ts);
+    s->tsc = rdtsc();
+}
+
+static void report(const char *test, const char *args, uint32_t ops,
+                   const stamp_t *a, const stamp_t *b) {
+    double ns = (b->ts.tv_sec - a->ts.tv_sec) * 1e9 + (b->ts.tv_nsec - a->ts.tv_nsec);
+    printf("BENCH %s %sops=%u ns_per_op=%.1f cycles_per_op=%.1f\n", test, args,
+           ops, ns / ops, (double)(b->tsc - a->tsc) / ops);
+}
+
+static void bench_pairs(uint32_t iters) {
+    static const uint32_t sizes[] = { 16, 100, 2048, 3000, 32768 };
+    stamp_t a, b;
+    char args[32];
+    uint32_t k, i;
+
+    for (k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        stamp(&a);
+        for (i = 0; i < iters; i++) {
+            void *p = kmalloc(sizes[k]);
+            *(volatile uint8_t*)p = 1;
+            kfree(p);
+        }
+        stamp(&b);
+        snprintf(args, sizeof(args), "size=%u ", sizes[k]);
+        report("host_malloc_free", args, iters, &a, &b);
+    }
+}
+
+/* Random replace over a live set: a steady-state mix of sizes */
+static void bench_trace(uint32_t iters) {
+    static void *live[BENCH_LIVE];
+    uint32_t rng = 1, i, failed = 0;
+    stamp_t a, b;
+    char args[32];
+
+    stamp(&a);
+    for (i = 0; i < iters; i++) {
+        uint32_t s = host_rand(&rng) % BENCH_LIVE;
+        uint32_t r = host_rand(&rng);
+        uint32_t size = (r & 7) ? 1 + r % 512 : 1 + r % 8192;
+        if (live[s]) kfree(live[s]);
+        live[s] = kmalloc(size);
+        if (!live[s]) failed++;
+    }
+    stamp(&b);
+    for (i = 0; i < BENCH_LIVE; i++) {
+        kfree(live[i]);
+        live[i] = NULL;
+    }
+    snprintf(args, sizeof(args), "live=%u failed=%u ", BENCH_LIVE, failed);
+    report("host_alloc_trace", args, iters, &a, &b);
+}
+
+/* The scheduler's hot path: pop the best task and requeue it */
+static void bench_runqueue(uint32_t iters) {
+    static runqueue_t rq;
+    uint32_t rng = 1, i;
+    stamp_t a, b;
+    char args[32];
+
+    rq_init(&rq);
+    for (i = 0; i < BENCH_RQ_TASKS; i++) {
+        rq_enqueue(&rq, i, host_rand(&rng) % NUM_PRIORITIES);
+    }
+    stamp(&a);
+    for (i = 0; i < iters; i++) {
+        int idx = rq_pop(&rq);
+        rq_enqueue(&rq, idx, host_rand(&rng) % NUM_PRIORITIES);
+    }
+    stamp(&b);
+    snprintf(args, sizeof(args), "tasks=%u ", BENCH_RQ_TASKS);
+    report("host_runqueue", args, iters, &a, &b);
+}
+
+int main(int argc, char **argv) {
+    uint32_t iters = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 10000000;
+
+    host_heap_init(BENCH_FRAMES);
+    bench_pairs(iters);
+    bench_trace(iters);
+    if (mem_check()) return 1;
+    bench_runqueue(iters);
+    return 0;
+}
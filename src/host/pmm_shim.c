@@ -0,0 +1,91 @@
+/* pmm_shim.c - Host page-frame allocator backed by one anonymous mapping */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "pmm.h"
+#include "memory.h"
+#include "host.h"
+
+/* The kernel modules keep addresses in uint32_t, so the arena has to live
+   in the low 4 GB (MAP_32BIT) */
+static uint32_t arena_base = 0;
+static uint32_t arena_frames = 0;
+static uint8_t *used = NULL;        /* one byte per frame */
+static uint32_t free_frames = 0;
+
+void host_pmm_init(uint32_t frames) {
+    void *p = mmap(NULL, (size_t)(frames + 1) * PAGE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    arena_base = ((uint32_t)(uintptr_t)p + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    arena_frames = frames;
+    used = calloc(frames, 1);
+    free_frames = frames;
+}
+
+static int frame_of(uint32_t addr, uint32_t *frame) {
+    if (addr < arena_base || addr % PAGE_SIZE) return -1;
+    *frame = (addr - arena_base) / PAGE_SIZE;
+    return *frame < arena_frames ? 0 : -1;
+}
+
+static void mark(uint32_t frame, uint32_t count, uint8_t val) {
+    uint32_t i;
+    for (i = 0; i < count; i++) used[frame + i] = val;
+    if (val) free_frames -= count;
+    else free_frames += count;
+}
+
+uint32_t pmm_alloc_contig(uint32_t count, uint32_t align) {
+    uint32_t f, i;
+    if (!count || !align) return 0;
+    for (f = 0; f + count <= arena_frames; f += align) {
+        for (i = 0; i < count && !used[f + i]; i++)
+            ;
+        if (i == count) {
+            mark(f, count, 1);
+            return arena_base + f * PAGE_SIZE;
+        }
+    }
+    return 0;
+}
+
+uint32_t pmm_alloc(void) {
+    return pmm_alloc_contig(1, 1);
+}
+
+int pmm_alloc_at(uint32_t addr, uint32_t count) {
+    uint32_t f, i;
+    if (frame_of(addr, &f) || f + count > arena_frames) return -1;
+    for (i = 0; i < count; i++)
+        if (used[f + i]) return -1;
+    mark(f, count, 1);
+    return 0;
+}
+
+void pmm_free_contig(uint32_t addr, uint32_t count) {
+    uint32_t f;
+    if (frame_of(addr, &f) || f + count > arena_frames) return;
+    mark(f, count, 0);
+}
+
+void pmm_free(uint32_t addr) {
+    pmm_free_contig(addr, 1);
+}
+
+uint32_t pmm_total_frames(void) {
+    return arena_frames;
+}
+
+uint32_t pmm_free_frames(void) {
+    return free_frames;
+}
+
+void host_heap_init(uint32_t frames) {
+    host_pmm_init(frames);
+    mem_init(pmm_alloc_contig(MEM_INITIAL_PAGES, 1), MEM_INITIAL_PAGES * PAGE_SIZE);
+}
@@ -0,0 +1,32 @@
+/* shim.c - Host stand-ins for the serial driver and kernel log */
+#include <stdio.h>
+#include "serial.h"
+#include "klog.h"
+#include "kprintf.h"
+
+void serial_write(const char* buf, size_t len) {
+    fwrite(buf, 1, len, stdout);
+}
+
+void serial_putc(char c) {
+    putchar(c);
+}
+
+void serial_puts(const char* str) {
+    fputs(str, stdout);
+}
+
+void serial_flush(void) {
+    fflush(stdout);
+}
+
+/* Records go straight to stderr so they stay out of benchmark output */
+void klog(const char *fmt, ...) {
+    char buf[256];
+    va_list ap;
+
+    va_start(ap, fmt);
+    kvsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    fputs(buf, stderr);
+}
@@ -0,0 +1,791 @@
+/* bench.c - In-kernel benchmarks */
+#include "bench.h"
+#include "cpu.h"
+#include "fpu.h"
+#include "io.h"
+#include "ipc.h"
+#include "kprintf.h"
+#include "memory.h"
+#include "paging.h"
+#include "pmm.h"
+#include "prof.h"
+#include "scheduler.h"
+#include "serial.h"
+#include "slab.h"
+#include "string.h"
+#include "sync.h"
+
+#define BENCH_TIMER_TICKS 200
+
+#define BENCH_FRAG_BLOCKS 768
+#define BENCH_FRAG_SIZE   16
+#define BENCH_LARGE_SIZE  3000
+#define BENCH_ALLOC_ITERS 10000
+
+#define BENCH_SLAB_BATCH  32
+#define BENCH_SLAB_ROUNDS 500
+#define BENCH_SLAB_LIVE   64
+
+#define BENCH_SERIAL_LINES 128
+
+#define BENCH_SWITCH_ROUNDS 20000
+#define BENCH_SWITCH_STACK  1024    /* words */
+
+#define SUITE_FPU_ROUNDS  2000
+
+#define BENCH_IPC_MSGS    20000
+#define BENCH_IPC_PAYLOAD 64
+
+#define BENCH_TLB_SIZES   5         /* 16, 64, 256, 1024, 4096 pages */
+#define BENCH_TLB_LOADS   65536
+
+#define SUITE_PINGPONG      10000
+#define SUITE_SPAWN         1000
+#define SUITE_BATCH         64
+#define SUITE_MALLOC_ROUNDS 200
+#define SUITE_LIVE          256
+#define SUITE_FRAG_OPS      20000
+
+#define BENCH_STR_BUF     8192
+#define BENCH_STR_BYTES   (256 * 1024)  /* bytes moved per measurement */
+
+/* ---- Timer / sleep queue ---- */
+
+static volatile int sleepers_stop;
+static volatile int sleepers_live;
+static uint32_t sleeper_seq;
+
+/* Sleeps on a private period (8..71 ticks) until told to stop */
+static void bench_sleeper(void) {
+    uint32_t period = 8 + (sleeper_seq++ % 64);
+    sleepers_live++;
+    while (!sleepers_stop) {
+        sleep_ticks(period);
+    }
+    sleepers_live--;
+    exit_task();
+}
+
+static void bench_timer_run(int want) {
+    sched_timer_stats_t st;
+    int created = 0;
+    uint32_t start;
+    int i;
+
+    sleepers_stop = 0;
+    sleepers_live = 0;
+    sleeper_seq = 0;
+    for (i = 0; i < want; i++) {
+        if (create_task(bench_sleeper, 1) < 0) break;
+        created++;
+    }
+
+    /* Let every sleeper run once and enter the sleep queue */
+    while (sleepers_live < created) yield();
+
+    sched_timer_stats_reset();
+    start = sched_get_ticks();
+    while (sched_get_ticks() - start < BENCH_TIMER_TICKS) yield();
+    sched_timer_stats(&st);
+
+    sleepers_stop = 1;
+    while (sleepers_live > 0) yield();
+
+    kprintf("  sleepers=%d ticks=%u wakeups=%u cycles/tick=%u cycles/wakeup=%u max=%u\n",
+            created, st.ticks, st.wakeups, st.ticks ? st.cycles / st.ticks : 0,
+            st.wakeups ? st.cycles / st.wakeups : 0, st.max_cycles);
+}
+
+void bench_timer(void) {
+    serial_puts("[BENCH] sleep queue wakeup cost\n");
+    bench_timer_run(16);
+    bench_timer_run(64);
+    bench_timer_run(MAX_TASKS - 16);
+}
+
+/* ---- Allocator ---- */
+
+static void *frag_blocks[BENCH_FRAG_BLOCKS];
+
+void bench_alloc(void) {
+    uint32_t cycles, worst = 0;
+    int n = 0;
+    int i;
+
+    serial_puts("[BENCH] malloc/free on a fragmented heap\n");
+
+    /* Fill the bottom of the heap with small blocks, then free every other
+       one: the heap now holds hundreds of blocks that are in use as far as
+       the first-fit path is concerned. */
+    for (i = 0; i < BENCH_FRAG_BLOCKS; i++) {
+        frag_blocks[i] = malloc(BENCH_FRAG_SIZE);
+        if (frag_blocks[i]) n++;
+    }
+    for (i = 0; i < BENCH_FRAG_BLOCKS; i += 2) {
+        free(frag_blocks[i]);
+        frag_blocks[i] = NULL;
+    }
+
+    uint64_t t0 = rdtsc();
+    for (i = 0; i < BENCH_ALLOC_ITERS; i++) {
+        uint64_t s = rdtsc();
+        void *p = malloc(BENCH_LARGE_SIZE);
+        free(p);
+        cycles = (uint32_t)(rdtsc() - s);
+        if (cycles > worst) worst = cycles;
+    }
+    cycles = (uint32_t)(rdtsc() - t0);
+
+    for (i = 0; i < BENCH_FRAG_BLOCKS; i++) {
+        free(frag_blocks[i]);
+        frag_blocks[i] = NULL;
+    }
+
+    kprintf("  blocks=%d size=%u iters=%u cycles/pair=%u max=%u\n", n,
+            BENCH_LARGE_SIZE, BENCH_ALLOC_ITERS, cycles / BENCH_ALLOC_ITERS, worst);
+}
+
+/* ---- Slab vs malloc ---- */
+
+static void *slab_objs[BENCH_SLAB_LIVE];
+
+/* Cycles per alloc+free pair in batches of BENCH_SLAB_BATCH */
+static uint32_t slab_pair_cycles(kmem_cache_t *c, uint32_t size) {
+    int r, i;
+    uint64_t t0 = rdtsc();
+    for (r = 0; r < BENCH_SLAB_ROUNDS; r++) {
+        for (i = 0; i < BENCH_SLAB_BATCH; i++) {
+            slab_objs[i] = c ? kmem_cache_alloc(c) : malloc(size);
+        }
+        for (i = BENCH_SLAB_BATCH - 1; i >= 0; i--) {
+            if (c) kmem_cache_free(c, slab_objs[i]);
+            else free(slab_objs[i]);
+        }
+    }
+    return (uint32_t)(rdtsc() - t0) / (BENCH_SLAB_ROUNDS * BENCH_SLAB_BATCH);
+}
+
+static void bench_slab_size(uint32_t size) {
+    kmem_cache_t *c = kmem_cache_create("bench", size, 8, NULL);
+    uint32_t payload = BENCH_SLAB_LIVE * size;
+    uint32_t slab_bytes, heap_bytes = 0;
+    int i;
+
+    if (!c) {
+        serial_puts("  cache creation failed\n");
+        return;
+    }
+
+    uint32_t slab_cyc = slab_pair_cycles(c, size);
+    uint32_t heap_cyc = slab_pair_cycles(NULL, size);
+
+    /* Memory consumed by BENCH_SLAB_LIVE live objects */
+    for (i = 0; i < BENCH_SLAB_LIVE; i++) slab_objs[i] = kmem_cache_alloc(c);
+    slab_bytes = kmem_cache_footprint(c);
+    for (i = 0; i < BENCH_SLAB_LIVE; i++) kmem_cache_free(c, slab_objs[i]);
+
+    for (i = 0; i < BENCH_SLAB_LIVE; i++) {
+        slab_objs[i] = malloc(size);
+        heap_bytes += mem_block_size(slab_objs[i]);
+    }
+    for (i = 0; i < BENCH_SLAB_LIVE; i++) free(slab_objs[i]);
+
+    kmem_cache_destroy(c);
+
+    kprintf("  size=%u slab: cycles/pair=%u overhead=%uB  malloc: cycles/pair=%u overhead=%uB\n",
+            size, slab_cyc, slab_bytes - payload, heap_cyc, heap_bytes - payload);
+}
+
+void bench_slab(void) {
+    kprintf("[BENCH] slab cache vs malloc (%u live objects for overhead)\n", BENCH_SLAB_LIVE);
+    bench_slab_size(32);
+    bench_slab_size(256);
+    bench_slab_size(2048);
+    bench_slab_size(3072);
+}
+
+/* ---- String kernels ---- */
+
+static uint8_t str_src[BENCH_STR_BUF + 16] __attribute__((aligned(16)));
+static uint8_t str_dst[BENCH_STR_BUF + 16] __attribute__((aligned(16)));
+
+typedef void* (*copy_fn)(void*, const void*, size_t);
+typedef void* (*fill_fn)(void*, int, size_t);
+
+/* Bytes per 100 cycles, so results stay integral for small sizes */
+static uint32_t str_rate(uint64_t cycles) {
+    uint32_t c = (uint32_t)cycles;
+    if (c == 0) c = 1;
+    return (BENCH_STR_BYTES * 100u) / c;
+}
+
+static uint32_t copy_rate(copy_fn fn, uint32_t size, uint32_t misalign) {
+    uint32_t reps = BENCH_STR_BYTES / size;
+    uint32_t i;
+    uint64_t t0 = rdtsc();
+    for (i = 0; i < reps; i++) {
+        fn(str_dst + misalign, str_src + 1, size);
+    }
+    return str_rate(rdtsc() - t0);
+}
+
+static uint32_t fill_rate(fill_fn fn, uint32_t size, uint32_t misalign) {
+    uint32_t reps = BENCH_STR_BYTES / size;
+    uint32_t i;
+    uint64_t t0 = rdtsc();
+    for (i = 0; i < reps; i++) {
+        fn(str_dst + misalign, (int)i, size);
+    }
+    return str_rate(rdtsc() - t0);
+}
+
+void bench_string(void) {
+    static const uint32_t sizes[] = { 16, 64, 256, 1024, 8192 };
+    static const uint32_t offsets[] = { 0, 3 };
+    uint32_t s, o;
+
+    memset(str_src, 0x5A, sizeof(str_src));
+    serial_puts("[BENCH] memcpy/memset throughput, bytes per 100 cycles\n");
+    serial_puts("  (source offset 1; destination offset as shown)\n");
+    for (o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++) {
+        for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            uint32_t size = sizes[s];
+            uint32_t off = offsets[o];
+            kprintf("  size=%u dst+%u copy: words=%u rep=%u", size, off,
+                    copy_rate(memcpy_words, size, off), copy_rate(memcpy_rep, size, off));
+            if (cpu_sse2_enabled()) {
+                kprintf(" sse2=%u", copy_rate(memcpy_sse2, size, off));
+            }
+            kprintf(" | fill: words=%u rep=%u", fill_rate(memset_words, size, off),
+                    fill_rate(memset_rep, size, off));
+            if (cpu_sse2_enabled()) {
+                kprintf(" sse2=%u", fill_rate(memset_sse2, size, off));
+            }
+            serial_puts("\n");
+        }
+    }
+}
+
+/* ---- Console throughput ---- */
+
+/* Push BENCH_SERIAL_LINES lines through serial_write() and wait for the
+   UART to take them; returns wire bytes and elapsed ticks */
+static uint32_t serial_run(uint32_t *ticks) {
+    static const char line[] =
+        "[BENCH] serial 0123456789abcdefghijklmnopqrstuvwxyz0123456789\n";
+    uint32_t len = sizeof(line) - 1;
+    int i;
+
+    serial_flush();
+    uint32_t t0 = sched_get_ticks();
+    for (i = 0; i < BENCH_SERIAL_LINES; i++) {
+        serial_write(line, len);
+    }
+    serial_flush();
+    *ticks = sched_get_ticks() - t0;
+    if (*ticks == 0) *ticks = 1;
+    return BENCH_SERIAL_LINES * (len + 1);      /* CRLF on the wire */
+}
+
+void bench_serial(void) {
+    uint32_t elapsed;
+    uint32_t bytes = serial_run(&elapsed);
+
+    kprintf("[BENCH] serial: %u bytes in %u ticks = %u bytes/sec at %u baud"
+            " (line limit %u bytes/sec)\n", bytes, elapsed, bytes * SCHED_HZ / elapsed,
+            serial_get_baud(), serial_get_baud() / 10);
+}
+
+/* ---- Raw context switch ----
+ * The bench task and a helper bounce between each other by calling the
+ * switch routine directly, so only the register save/restore and stack
+ * swap are timed (no scheduler bookkeeping). */
+
+extern void context_switch(uint32_t **old_sp, uint32_t *new_sp);
+void context_switch_pusha(uint32_t **old_sp, uint32_t *new_sp);
+
+/* The previous full-save switch (all eight GPRs with pusha, frame
+   [EDI][ESI][EBP][ESP][EBX][EDX][ECX][EAX][EIP]), kept here only as the
+   baseline for the callee-saved context_switch() in sched.S */
+__asm__ (".text\n"
+         "context_switch_pusha:\n\t"
+         "movl 4(%esp), %eax\n\t"
+         "movl 8(%esp), %edx\n\t"
+         "pusha\n\t"
+         "movl %esp, (%eax)\n\t"
+         "movl %edx, %esp\n\t"
+         "popa\n\t"
+         "ret\n");
+
+typedef void (*switch_fn_t)(uint32_t **old_sp, uint32_t *new_sp);
+
+static uint32_t switch_stack[BENCH_SWITCH_STACK];
+static uint32_t *switch_main_sp, *switch_helper_sp;
+static switch_fn_t switch_fn;
+
+static void switch_helper(void) {
+    while (1) {
+        switch_fn(&switch_helper_sp, switch_main_sp);
+    }
+}
+
+/* Cycles per one-way switch with fn; saved_words is the number of
+   registers fn keeps on the stack besides the return address */
+static uint32_t switch_run(switch_fn_t fn, int saved_words) {
+    uint32_t *stk = switch_stack + BENCH_SWITCH_STACK;
+    int i;
+
+    *(--stk) = (uint32_t)switch_helper;
+    for (i = 0; i < saved_words; i++) *(--stk) = 0;
+    switch_helper_sp = stk;
+    switch_fn = fn;
+
+    uint32_t flags = irq_save();
+    uint64_t t0 = rdtsc();
+    for (i = 0; i < BENCH_SWITCH_ROUNDS; i++) {
+        fn(&switch_main_sp, switch_helper_sp);
+    }
+    uint32_t cycles = (uint32_t)(rdtsc() - t0);
+    irq_restore(flags);
+    return cycles / (2 * BENCH_SWITCH_ROUNDS);
+}
+
+void bench_switch(void) {
+    uint32_t full = switch_run(context_switch_pusha, 8);
+    uint32_t lean = switch_run(context_switch, 4);
+
+    kprintf("[BENCH] context switch, %u round trips (cycles per switch)\n",
+            BENCH_SWITCH_ROUNDS);
+    kprintf("  pusha/popa (8 regs):   %u\n", full);
+    kprintf("  callee-saved (4 regs): %u\n", lean);
+}
+
+/* ---- IPC message throughput ---- */
+
+static volatile int ipc_port = -1;
+static volatile int ipc_done;
+static uint32_t ipc_errors;
+static uint64_t ipc_t0, ipc_t1;
+
+/* Allocates a payload per message and hands it over; never touches it
+   again once sent */
+static void ipc_producer(void) {
+    uint32_t i;
+    while (ipc_port < 0) yield();
+
+    ipc_t0 = rdtsc();
+    for (i = 0; i < BENCH_IPC_MSGS; i++) {
+        uint32_t *buf = malloc(BENCH_IPC_PAYLOAD);
+        if (buf) buf[0] = i;
+        if (ipc_send(ipc_port, i, buf, BENCH_IPC_PAYLOAD) != IPC_OK) {
+            ipc_errors++;
+            free(buf);
+        }
+    }
+    exit_task();
+}
+
+/* Receives in order, checks the payload and frees it */
+static void ipc_consumer(void) {
+    ipc_msg_t msg;
+    uint32_t i;
+    int port = ipc_port_create();
+
+    ipc_port = port;
+    for (i = 0; i < BENCH_IPC_MSGS; i++) {
+        if (ipc_recv(port, &msg) != IPC_OK) {
+            ipc_errors++;
+            break;
+        }
+        if (msg.type != i || !msg.data || *(uint32_t*)msg.data != i) ipc_errors++;
+        free(msg.data);
+    }
+    ipc_t1 = rdtsc();
+    ipc_port_destroy(port);
+    ipc_port = -1;
+    ipc_done = 1;
+    exit_task();
+}
+
+/* One producer/consumer run; returns cycles per message */
+static uint32_t ipc_run(int consumer_prio) {
+    ipc_port = -1;
+    ipc_done = 0;
+    ipc_errors = 0;
+    create_task(ipc_consumer, consumer_prio);
+    create_task(ipc_producer, 1);
+    while (!ipc_done) yield();
+    return (uint32_t)(ipc_t1 - ipc_t0) / BENCH_IPC_MSGS;
+}
+
+/* Messages per second at khz TSC kHz, without overflowing 32 bits */
+static uint32_t per_sec(uint32_t khz, uint32_t cycles) {
+    if (!cycles) return 0;
+    return khz / cycles * 1000 + khz % cycles * 1000 / cycles;
+}
+
+void bench_ipc(void) {
+    uint32_t khz = prof_tsc_khz();
+    uint32_t same = ipc_run(1);
+    uint32_t same_err = ipc_errors;
+    uint32_t high = ipc_run(2);
+
+    kprintf("[BENCH] IPC: %u messages of %u bytes, buffer handed off by pointer\n",
+            BENCH_IPC_MSGS, BENCH_IPC_PAYLOAD);
+    kprintf("  consumer same prio:   %u cycles/msg, %u msgs/sec (errors %u)\n",
+            same, per_sec(khz, same), same_err);
+    kprintf("  consumer higher prio: %u cycles/msg, %u msgs/sec (errors %u)\n",
+            high, per_sec(khz, high), ipc_errors);
+}
+
+/* ---- TLB reach ----
+ * A chain of dependent loads touching one cache line per page, in a
+ * scrambled page order, over working sets of 64 KB to 16 MB. Once a set
+ * outgrows the TLB each load also pays for a page walk, which 4 MB pages
+ * (and running without paging) avoid. */
+
+static const int tlb_modes[3] = { PAGING_OFF, PAGING_4K, PAGING_4M };
+static const char *tlb_mode_names[3] = { "off", "4k", "4m" };
+static void * volatile tlb_sink;
+
+/* Link one node per page of buf[0..pages) into a ring and return its
+   head. pages is a power of two, so the odd multiplier permutes them;
+   each node sits on a different cache line of its page. */
+static void **tlb_chain(uint8_t *buf, uint32_t pages) {
+    void **first = NULL, **prev = NULL;
+    uint32_t k;
+    for (k = 0; k < pages; k++) {
+        uint32_t pg = (k * 2654435761u) & (pages - 1);
+        void **node = (void**)(buf + pg * PAGE_SIZE + (pg % 64) * 64);
+        if (prev) *prev = node; else first = node;
+        prev = node;
+    }
+    *prev = first;
+    return first;
+}
+
+/* Cycles per load walking the ring over pages pages */
+static uint32_t tlb_run(uint8_t *buf, uint32_t pages) {
+    void **p = tlb_chain(buf, pages);
+    uint32_t i;
+
+    uint32_t flags = irq_save();
+    for (i = 0; i < pages; i++) p = *p;    /* warm the caches and TLB */
+    uint64_t t0 = rdtsc();
+    for (i = 0; i < BENCH_TLB_LOADS; i++) p = *p;
+    uint32_t cycles = (uint32_t)(rdtsc() - t0);
+    irq_restore(flags);
+    tlb_sink = p;
+    return cycles / BENCH_TLB_LOADS;
+}
+
+/* Fill res[mode][size] (0 = mode unavailable or set too large for the
+   frames we got) and restore the paging mode. Returns -1 if not even the
+   smallest working set could be allocated. */
+static int tlb_sweep(uint32_t res[3][BENCH_TLB_SIZES]) {
+    uint32_t max = 16u << (2 * (BENCH_TLB_SIZES - 1));
+    uint32_t base = 0;
+    int saved = paging_mode();
+    int m, i;
+
+    uint32_t flags = irq_save();
+    for (; max >= 16; max /= 2) {
+        base = pmm_alloc_contig(max, 1);
+        if (base) break;
+    }
+    irq_restore(flags);
+    if (!base) return -1;
+    for (m = 0; m < 3; m++) {
+        int ok = paging_set_mode(tlb_modes[m]) == 0;
+        for (i = 0; i < BENCH_TLB_SIZES; i++) {
+            uint32_t pages = 16u << (2 * i);
+            res[m][i] = ok && pages <= max ? tlb_run((uint8_t*)base, pages) : 0;
+        }
+    }
+    paging_set_mode(saved);
+    flags = irq_save();
+    pmm_free_contig(base, max);
+    irq_restore(flags);
+    return 0;
+}
+
+void bench_tlb(void) {
+    uint32_t res[3][BENCH_TLB_SIZES];
+    int i;
+
+    if (tlb_sweep(res) < 0) {
+        serial_puts("[BENCH] TLB: no frames for the working set\n");
+        return;
+    }
+    kprintf("[BENCH] TLB reach, %u dependent loads, one line per page (cycles per load)\n",
+            BENCH_TLB_LOADS);
+    serial_puts("  pages\t  KB\toff\t4 KB\t4 MB\n");
+    for (i = 0; i < BENCH_TLB_SIZES; i++) {
+        uint32_t pages = 16u << (2 * i);
+        kprintf("  %u\t%u\t%u\t%u\t%u\n", pages, pages * (PAGE_SIZE / 1024),
+                res[0][i], res[1][i], res[2][i]);
+    }
+    serial_puts("  (0: mode unsupported or working set not allocated)\n");
+}
+
+/* ---- Headless suite ----
+ * Every result is one line: "BENCH <test> key=value ...", so runs can be
+ * grepped and compared between commits. */
+
+static volatile int pp_done;
+static void *suite_ptrs[SUITE_LIVE];
+
+static void pingpong_task(void) {
+    int i;
+    for (i = 0; i < SUITE_PINGPONG; i++) {
+        yield();
+    }
+    __atomic_fetch_add(&pp_done, 1, __ATOMIC_RELAXED);
+}
+
+static void noop_task(void) {
+}
+
+/* Two equal-priority tasks yielding to each other */
+static void suite_pingpong(void) {
+    pp_done = 0;
+    create_task(pingpong_task, 1);
+    create_task(pingpong_task, 1);
+    uint64_t t0 = rdtsc();
+    while (pp_done < 2) {
+        yield();
+    }
+    uint32_t cycles = (uint32_t)(rdtsc() - t0);
+    kprintf("BENCH yield_pingpong switches=%u cycles_per_switch=%u\n",
+            2 * SUITE_PINGPONG, cycles / (2 * SUITE_PINGPONG));
+}
+
+static semaphore_t sem_ping, sem_pong, sem_done;
+
+static void sem_ping_task(void) {
+    int i;
+    for (i = 0; i < SUITE_PINGPONG; i++) {
+        sem_post(&sem_pong);
+        sem_wait(&sem_ping);
+    }
+    sem_post(&sem_done);
+}
+
+static void sem_pong_task(void) {
+    int i;
+    for (i = 0; i < SUITE_PINGPONG; i++) {
+        sem_wait(&sem_pong);
+        sem_post(&sem_ping);
+    }
+    sem_post(&sem_done);
+}
+
+/* Two tasks handing control back and forth through semaphores; the
+   waiting side sleeps instead of polling */
+static void suite_sem_pingpong(void) {
+    sem_init(&sem_ping, 0);
+    sem_init(&sem_pong, 0);
+    sem_init(&sem_done, 0);
+    uint64_t t0 = rdtsc();
+    create_task(sem_ping_task, 1);
+    create_task(sem_pong_task, 1);
+    sem_wait(&sem_done);
+    sem_wait(&sem_done);
+    uint32_t cycles = (uint32_t)(rdtsc() - t0);
+    kprintf("BENCH sem_pingpong handoffs=%u cycles_per_handoff=%u\n",
+            2 * SUITE_PINGPONG, cycles / (2 * SUITE_PINGPONG));
+}
+
+/* create_task() + first dispatch + exit of an empty task */
+static void suite_spawn(void) {
+    uint32_t worst = 0;
+    int i, failed = 0;
+    uint64_t t0 = rdtsc();
+    for (i = 0; i < SUITE_SPAWN; i++) {
+        uint64_t s = rdtsc();
+        if (create_task(noop_task, 1) < 0) failed++;
+        yield();
+        uint32_t c = (uint32_t)(rdtsc() - s);
+        if (c > worst) worst = c;
+    }
+    uint32_t cycles = (uint32_t)(rdtsc() - t0);
+    kprintf("BENCH task_spawn tasks=%u failed=%u cycles_per_task=%u max=%u\n",
+            SUITE_SPAWN, failed, cycles / SUITE_SPAWN, worst);
+}
+
+static uint32_t lcg_state;
+
+static uint32_t lcg(void) {
+    lcg_state = lcg_state * 1103515245u + 12345u;
+    return lcg_state >> 8;
+}
+
+/* Batches of same-size allocations freed in reverse, one size at a time */
+static void suite_malloc_sizes(void) {
+    static const uint32_t sizes[] = { 16, 64, 256, 1024, 4096 };
+    uint32_t k;
+    int r, i;
+
+    for (k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        uint64_t t0 = rdtsc();
+        for (r = 0; r < SUITE_MALLOC_ROUNDS; r++) {
+            for (i = 0; i < SUITE_BATCH; i++) suite_ptrs[i] = malloc(sizes[k]);
+            for (i = SUITE_BATCH - 1; i >= 0; i--) free(suite_ptrs[i]);
+        }
+        uint32_t cycles = (uint32_t)(rdtsc() - t0);
+        kprintf("BENCH malloc_free size=%u pairs=%u cycles_per_pair=%u\n", sizes[k],
+                SUITE_MALLOC_ROUNDS * SUITE_BATCH,
+                cycles / (SUITE_MALLOC_ROUNDS * SUITE_BATCH));
+    }
+}
+
+/* Random sizes (16..4096) with a random live set: alloc or free a random
+   slot per step, then report how scattered the free space ended up */
+static void suite_fragmentation(void) {
+    mem_info_t mi;
+    uint32_t worst = 0, failed = 0;
+    int i;
+
+    lcg_state = 12345;
+    for (i = 0; i < SUITE_LIVE; i++) suite_ptrs[i] = NULL;
+
+    uint64_t t0 = rdtsc();
+    for (i = 0; i < SUITE_FRAG_OPS; i++) {
+        uint32_t slot = lcg() % SUITE_LIVE;
+        uint64_t s = rdtsc();
+        if (suite_ptrs[slot]) {
+            free(suite_ptrs[slot]);
+            suite_ptrs[slot] = NULL;
+        } else {
+            suite_ptrs[slot] = malloc(16 << (lcg() % 9));
+            if (!suite_ptrs[slot]) failed++;
+        }
+        uint32_t c = (uint32_t)(rdtsc() - s);
+        if (c > worst) worst = c;
+    }
+    uint32_t cycles = (uint32_t)(rdtsc() - t0);
+
+    mem_info(&mi);
+    /* share of free bytes outside the largest free block */
+    uint32_t frag = 0;
+    if (mi.free) {
+        uint32_t f = mi.free, l = mi.largest_free;
+        while (f > 0x1000000) {
+            f >>= 4;
+            l >>= 4;
+        }
+        frag = 100 - l * 100 / f;
+    }
+    kprintf("BENCH fragmentation ops=%u failed=%u cycles_per_op=%u max=%u"
+            " heap=%u free_blocks=%u frag_pct=%u\n", SUITE_FRAG_OPS, failed,
+            cycles / SUITE_FRAG_OPS, worst, mi.heap_size, mi.free_blocks, frag);
+
+    for (i = 0; i < SUITE_LIVE; i++) {
+        free(suite_ptrs[i]);
+        suite_ptrs[i] = NULL;
+    }
+}
+
+/* Batched (equal priorities) and switch-per-message (consumer outranks
+   the producer) handoff */
+static void suite_ipc(void) {
+    uint32_t khz = prof_tsc_khz();
+    int prio;
+    for (prio = 1; prio <= 2; prio++) {
+        uint32_t c = ipc_run(prio);
+        kprintf("BENCH ipc consumer_prio=%d msgs=%u errors=%u cycles_per_msg=%u"
+                " msgs_per_sec=%u\n", prio, BENCH_IPC_MSGS, ipc_errors, c,
+                per_sec(khz, c));
+    }
+}
+
+static void suite_switch(void) {
+    kprintf("BENCH context_switch variant=pusha cycles_per_switch=%u\n",
+            switch_run(context_switch_pusha, 8));
+    kprintf("BENCH context_switch variant=callee_saved cycles_per_switch=%u\n",
+            switch_run(context_switch, 4));
+}
+
+static uint32_t fpu_seq;
+static uint32_t fpu_errors;
+
+static void xmm0_set(uint32_t v) {
+    __asm__ volatile ("movd %0, %%xmm0" : : "r"(v));
+}
+
+static uint32_t xmm0_get(void) {
+    uint32_t v;
+    __asm__ volatile ("movd %%xmm0, %0" : "=r"(v));
+    return v;
+}
+
+/* Keeps a private value in xmm0 across yields to the other FPU task */
+static void fpu_task(void) {
+    uint32_t mine = 0x5EED0000 + fpu_seq++;
+    int i;
+    xmm0_set(mine);
+    for (i = 0; i < SUITE_FPU_ROUNDS; i++) {
+        yield();
+        if (xmm0_get() != mine) fpu_errors++;
+    }
+    sem_post(&sem_done);
+}
+
+/* Two tasks alternating on the FPU: each switch costs one lazy save and
+   restore, and xmm0 must survive every one of them */
+static void suite_fpu(void) {
+    fpu_stats_t a, b;
+
+    if (!cpu_sse2_enabled()) return;
+    fpu_errors = 0;
+    sem_init(&sem_done, 0);
+    fpu_get_stats(&a);
+    uint64_t t0 = rdtsc();
+    create_task(fpu_task, 1);
+    create_task(fpu_task, 1);
+    sem_wait(&sem_done);
+    sem_wait(&sem_done);
+    uint32_t cycles = (uint32_t)(rdtsc() - t0);
+    fpu_get_stats(&b);
+    kprintf("BENCH fpu_lazy rounds=%u errors=%u cycles_per_yield=%u switches=%u"
+            " traps=%u lazy_restores=%u saves=%u first_use=%u\n", SUITE_FPU_ROUNDS,
+            fpu_errors, cycles / (2 * SUITE_FPU_ROUNDS), b.switches - a.switches,
+            b.traps - a.traps, b.restores - a.restores, b.saves - a.saves,
+            b.inits - a.inits);
+}
+
+static void suite_tlb(void) {
+    uint32_t res[3][BENCH_TLB_SIZES];
+    int m, i;
+
+    if (tlb_sweep(res) < 0) return;
+    for (m = 0; m < 3; m++) {
+        for (i = 0; i < BENCH_TLB_SIZES; i++) {
+            if (!res[m][i]) continue;
+            kprintf("BENCH tlb paging=%s pages=%u cycles_per_load=%u\n",
+                    tlb_mode_names[m], 16u << (2 * i), res[m][i]);
+        }
+    }
+}
+
+static void suite_serial(void) {
+    uint32_t elapsed;
+    uint32_t bytes = serial_run(&elapsed);
+    kprintf("BENCH serial bytes=%u ticks=%u bytes_per_sec=%u baud=%u\n", bytes,
+            elapsed, bytes * SCHED_HZ / elapsed, serial_get_baud());
+}
+
+void bench_suite(void) {
+    kprintf("BENCH start tsc_khz=%u hz=%u\n", prof_tsc_khz(), SCHED_HZ);
+    suite_switch();
+    suite_pingpong();
+    suite_sem_pingpong();
+    suite_fpu();
+    suite_spawn();
+    suite_malloc_sizes();
+    suite_fragmentation();
+    suite_ipc();
+    suite_tlb();
+    suite_serial();
+    serial_puts("BENCH done\n");
+}
@@ -0,0 +1,38 @@
+/* bench.h - In-kernel benchmarks */
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "types.h"
+
+/* Sleep-queue wakeup cost per tick with hundreds of sleeping tasks */
+void bench_timer(void);
+
+/* First-fit malloc/free latency on a heap fragmented by small blocks */
+void bench_alloc(void);
+
+/* Slab cache vs malloc(): alloc/free throughput and memory overhead */
+void bench_slab(void);
+
+/* memcpy/memset kernels across sizes and destination alignments */
+void bench_string(void);
+
+/* Console output rate through serial_write() at the current baud rate */
+void bench_serial(void);
+
+/* Raw context_switch() cost: callee-saved-only vs the old pusha/popa */
+void bench_switch(void);
+
+/* Producer/consumer message throughput through an IPC port */
+void bench_ipc(void);
+
+/* Dependent-load latency over growing working sets with paging off,
+   4 KB pages and 4 MB pages */
+void bench_tlb(void);
+
+/* Headless suite (boot with "bench" on the command line): raw switch,
+   yield and semaphore handoff latency, lazy FPU switching, task spawn,
+   malloc/free mixes, fragmentation, IPC, TLB reach and serial
+   throughput, printed as "BENCH <test> key=value ..." lines */
+void bench_suite(void);
+
+#endif
@@ -0,0 +1,48 @@
+/* cpu.c - CPU feature detection and control-register setup */
+#include "cpu.h"
+#include "klog.h"
+#include "serial.h"
+
+#define CR0_MP          (1u << 1)
+#define CR0_EM          (1u << 2)
+#define CR4_OSFXSR      (1u << 9)
+#define CR4_OSXMMEXCPT  (1u << 10)
+
+static uint32_t features_edx = 0;
+static int sse2_enabled = 0;
+static char vendor[13];
+
+void cpu_init(void) {
+    uint32_t a, b, c, d;
+
+    cpuid(0, &a, &b, &c, &d);
+    *(uint32_t*)&vendor[0] = b;
+    *(uint32_t*)&vendor[4] = d;
+    *(uint32_t*)&vendor[8] = c;
+    vendor[12] = '\0';
+
+    if (a >= 1) {
+        cpuid(1, &a, &b, &c, &d);
+        features_edx = d;
+    }
+
+    const char *sse = "";
+
+    if ((features_edx & (CPUID_EDX_SSE | CPUID_EDX_SSE2 | CPUID_EDX_FXSR)) ==
+        (CPUID_EDX_SSE | CPUID_EDX_SSE2 | CPUID_EDX_FXSR)) {
+        write_cr0((read_cr0() & ~CR0_EM) | CR0_MP);
+        write_cr4(read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+        __asm__ volatile ("fninit");
+        sse2_enabled = 1;
+        sse = ", SSE2 enabled";
+    }
+    klog("[CPU] %s%s\n", vendor, sse);
+}
+
+uint32_t cpu_features(void) {
+    return features_edx;
+}
+
+int cpu_sse2_enabled(void) {
+    return sse2_enabled;
+}
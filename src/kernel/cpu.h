@@ -0,0 +1,73 @@
+/* cpu.h - CPU feature detection and control-register setup */
+#ifndef CPU_H
+#define CPU_H
+
+#include "types.h"
+
+/* CPUID leaf 1 EDX feature bits */
+#define CPUID_EDX_TSC   (1u << 4)
+#define CPUID_EDX_PSE   (1u << 3)
+#define CPUID_EDX_PGE   (1u << 13)
+#define CPUID_EDX_FXSR  (1u << 24)
+#define CPUID_EDX_SSE   (1u << 25)
+#define CPUID_EDX_SSE2  (1u << 26)
+
+/* Detect features and enable SSE (CR0.EM=0, CR0.MP=1, CR4.OSFXSR and
+   CR4.OSXMMEXCPT) when the CPU supports it */
+void cpu_init(void);
+
+/* CPUID leaf 1 EDX as read by cpu_init() */
+uint32_t cpu_features(void);
+
+/* SSE/SSE2 instructions are supported and enabled */
+int cpu_sse2_enabled(void);
+
+static inline void cpuid(uint32_t leaf, uint32_t *a, uint32_t *b,
+                         uint32_t *c, uint32_t *d) {
+    __asm__ volatile ("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d)
+                      : "a"(leaf), "c"(0));
+}
+
+static inline uint32_t read_cr0(void) {
+    uint32_t v;
+    __asm__ volatile ("movl %%cr0, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr0(uint32_t v) {
+    __asm__ volatile ("movl %0, %%cr0" : : "r"(v) : "memory");
+}
+
+static inline uint32_t read_cr2(void) {
+    uint32_t v;
+    __asm__ volatile ("movl %%cr2, %0" : "=r"(v));
+    return v;
+}
+
+static inline uint32_t read_cr3(void) {
+    uint32_t v;
+    __asm__ volatile ("movl %%cr3, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr3(uint32_t v) {
+    __asm__ volatile ("movl %0, %%cr3" : : "r"(v) : "memory");
+}
+
+/* Drop the TLB entry (of any page size) covering addr, and the cached
+   page-directory entries with it */
+static inline void invlpg(uint32_t addr) {
+    __asm__ volatile ("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t v;
+    __asm__ volatile ("movl %%cr4, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr4(uint32_t v) {
+    __asm__ volatile ("movl %0, %%cr4" : : "r"(v) : "memory");
+}
+
+#endif
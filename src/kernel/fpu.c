@@ -0,0 +1,130 @@
+/* fpu.c - Lazy FPU/SSE context switching (CR0.TS and #NM) */
+#include "fpu.h"
+#include "cpu.h"
+#include "idt.h"
+#include "io.h"
+#include "klog.h"
+#include "kprintf.h"
+#include "serial.h"
+#include "slab.h"
+
+#define CR0_TS (1u << 3)
+#define FXSAVE_MXCSR 24         /* offset of MXCSR in the FXSAVE area */
+#define MXCSR_DEFAULT 0x1F80    /* all SIMD exceptions masked */
+
+static int lazy = 0;                /* FXSR present and switching enabled */
+static int ts_set = 0;              /* mirrors CR0.TS */
+static pcb_t *owner = NULL;         /* task whose state is in the registers */
+static kmem_cache_t *state_cache = NULL;
+static uint8_t clean_state[FPU_STATE_SIZE] __attribute__((aligned(16)));
+static fpu_stats_t stats;
+
+static void fxsave(void *area) {
+    __asm__ volatile ("fxsave (%0)" : : "r"(area) : "memory");
+}
+
+static void fxrstor(const void *area) {
+    __asm__ volatile ("fxrstor (%0)" : : "r"(area) : "memory");
+}
+
+static void set_ts(void) {
+    write_cr0(read_cr0() | CR0_TS);
+    ts_set = 1;
+}
+
+static void clear_ts(void) {
+    __asm__ volatile ("clts");
+    ts_set = 0;
+}
+
+/* #NM: the running task touched the FPU while another task's state (or
+   none) is loaded. Hand the registers over. */
+static void nm_handler(interrupt_frame_t *f) {
+    pcb_t *cur = sched_current();
+
+    clear_ts();
+    stats.traps++;
+    if (owner == cur) return;
+
+    if (owner) {
+        fxsave(owner->fpu_state);
+        stats.saves++;
+    }
+    if (cur->fpu_state) {
+        fxrstor(cur->fpu_state);
+        stats.restores++;
+    } else {
+        cur->fpu_state = kmem_cache_alloc(state_cache);
+        if (!cur->fpu_state) {
+            kprintf("\n[FPU] No memory for pid %d's FPU state (eip=0x%08x)\n"
+                    "[FPU] System halted\n", cur->pid, f->eip);
+            while (1) {
+                __asm__ volatile ("cli; hlt");
+            }
+        }
+        fxrstor(clean_state);
+        stats.inits++;
+    }
+    owner = cur;
+}
+
+void fpu_init(void) {
+    if (!cpu_sse2_enabled()) {
+        klog("[FPU] No FXSR, lazy switching off\n");
+        return;
+    }
+
+    /* Template for first use: fninit state with default MXCSR */
+    __asm__ volatile ("fninit");
+    fxsave(clean_state);
+    *(uint32_t*)(clean_state + FXSAVE_MXCSR) = MXCSR_DEFAULT;
+
+    state_cache = kmem_cache_create("fpu_state", FPU_STATE_SIZE, 16, NULL);
+    exception_register(EXC_DEVICE_NOT_AVAILABLE, nm_handler);
+    owner = NULL;
+    lazy = 1;
+    set_ts();
+    klog("[FPU] Lazy FXSAVE/FXRSTOR switching on\n");
+}
+
+void fpu_switch(pcb_t *next) {
+    if (!lazy) return;
+    stats.switches++;
+    if (next == owner) {
+        stats.resumed++;
+        if (ts_set) clear_ts();
+    } else if (!ts_set) {
+        set_ts();
+    }
+}
+
+void fpu_release(pcb_t *t) {
+    if (!lazy) return;
+    uint32_t flags = irq_save();
+    if (owner == t) owner = NULL;
+    if (t->fpu_state) {
+        kmem_cache_free(state_cache, t->fpu_state);
+        t->fpu_state = NULL;
+    }
+    irq_restore(flags);
+}
+
+void fpu_get_stats(fpu_stats_t *out) {
+    uint32_t flags = irq_save();
+    *out = stats;
+    irq_restore(flags);
+}
+
+void fpu_stats(void) {
+    fpu_stats_t st;
+
+    if (!lazy) {
+        serial_puts("Lazy FPU switching is off (no FXSR)\n");
+        return;
+    }
+    fpu_get_stats(&st);
+    kprintf("[FPU] switches=%u resumed_owner=%u traps=%u\n",
+            st.switches, st.resumed, st.traps);
+    kprintf("[FPU] lazy_restores=%u saves=%u first_use=%u\n",
+            st.restores, st.saves, st.inits);
+}
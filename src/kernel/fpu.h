@@ -0,0 +1,38 @@
+/* fpu.h - Lazy FPU/SSE context switching (CR0.TS and #NM) */
+#ifndef FPU_H
+#define FPU_H
+
+#include "types.h"
+#include "scheduler.h"
+
+#define FPU_STATE_SIZE 512      /* FXSAVE area, 16-byte aligned */
+
+/* Every switch sets CR0.TS unless the incoming task already owns the FPU
+   registers. The first FPU/SSE instruction of any other task then raises
+   #NM, and only at that point is the owner's state saved and the task's
+   own state restored. A task gets its save area on first use. */
+
+typedef struct {
+    uint32_t switches;      /* task switches seen */
+    uint32_t resumed;       /* switches back to the FPU owner (no trap) */
+    uint32_t traps;         /* #NM exceptions */
+    uint32_t saves;         /* FXSAVE of the previous owner */
+    uint32_t restores;      /* lazy FXRSTOR of a task's own state */
+    uint32_t inits;         /* first use: started from a clean state */
+} fpu_stats_t;
+
+/* Enable lazy switching (needs FXSR; call after sched_init) */
+void fpu_init(void);
+
+/* Called by the scheduler right before switching to next */
+void fpu_switch(pcb_t *next);
+
+/* Drop an exiting task's FPU state and save area */
+void fpu_release(pcb_t *t);
+
+void fpu_get_stats(fpu_stats_t *out);
+
+/* Print the counters */
+void fpu_stats(void);
+
+#endif
@@ -0,0 +1,232 @@
+/* idt.c - Interrupt descriptor table, exceptions and IRQ dispatch */
+#include "idt.h"
+#include "cpu.h"
+#include "io.h"
+#include "kprintf.h"
+#include "pic.h"
+#include "serial.h"
+
+#define IDT_ENTRIES 48
+#define IDT_INTERRUPT_GATE 0x8E    /* present, ring 0, 32-bit interrupt gate */
+#define IDT_TASK_GATE      0x85    /* present, ring 0, task gate */
+
+/* Our own flat GDT replaces the one the bootloader left behind. The two
+   TSSs exist only for the double-fault task gate: a #DF switches to a
+   separate task, so it can still be reported when the fault was caused by
+   running off the end of a stack (the CPU could not even push a frame). */
+#define GDT_ENTRIES 5
+#define KERNEL_CS   0x08
+#define KERNEL_DS   0x10
+#define MAIN_TSS    0x18
+#define DF_TSS      0x20
+
+#define DF_STACK_SIZE 4096
+
+typedef struct {
+    uint16_t limit_lo;
+    uint16_t base_lo;
+    uint8_t  base_mid;
+    uint8_t  access;
+    uint8_t  flags_limit_hi;
+    uint8_t  base_hi;
+} __attribute__((packed)) gdt_entry_t;
+
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) gdt_ptr_t;
+
+typedef struct {
+    uint32_t link, esp0, ss0, esp1, ss1, esp2, ss2;
+    uint32_t cr3, eip, eflags, eax, ecx, edx, ebx, esp, ebp, esi, edi;
+    uint32_t es, cs, ss, ds, fs, gs, ldt;
+    uint16_t trap, iomap;
+} __attribute__((packed)) tss_t;
+
+typedef struct {
+    uint16_t offset_lo;
+    uint16_t selector;
+    uint8_t  zero;
+    uint8_t  type_attr;
+    uint16_t offset_hi;
+} __attribute__((packed)) idt_entry_t;
+
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) idt_ptr_t;
+
+static gdt_entry_t gdt[GDT_ENTRIES];
+static tss_t main_tss, df_tss;
+static uint8_t df_stack[DF_STACK_SIZE] __attribute__((aligned(16)));
+
+static idt_entry_t idt[IDT_ENTRIES];
+static irq_handler_t irq_handlers[NUM_IRQS];
+static exception_handler_t exception_handlers[IRQ_BASE];
+
+extern uint32_t isr_stub_table[IDT_ENTRIES];
+
+static const char *exception_names[32] = {
+    "Divide error", "Debug", "NMI", "Breakpoint", "Overflow",
+    "BOUND range exceeded", "Invalid opcode", "Device not available",
+    "Double fault", "Coprocessor segment overrun", "Invalid TSS",
+    "Segment not present", "Stack-segment fault", "General protection fault",
+    "Page fault", "Reserved", "x87 floating-point", "Alignment check",
+    "Machine check", "SIMD floating-point", "Virtualization",
+    "Control protection", "Reserved", "Reserved", "Reserved", "Reserved",
+    "Reserved", "Reserved", "Reserved", "Reserved", "Security", "Reserved"
+};
+
+static void exception_panic(interrupt_frame_t *f);
+
+static void gdt_set(int i, uint32_t base, uint32_t limit, uint8_t access, uint8_t flags) {
+    gdt[i].limit_lo = limit & 0xFFFF;
+    gdt[i].base_lo = base & 0xFFFF;
+    gdt[i].base_mid = (base >> 16) & 0xFF;
+    gdt[i].access = access;
+    gdt[i].flags_limit_hi = (flags << 4) | ((limit >> 16) & 0x0F);
+    gdt[i].base_hi = (base >> 24) & 0xFF;
+}
+
+/* Entered by the #DF task switch on df_stack; the interrupted state is in
+   main_tss. Rebuilds an interrupt frame from it for the vector 8 handler. */
+static void __attribute__((noreturn)) double_fault_task(void) {
+    interrupt_frame_t f;
+
+    __asm__ volatile ("clts");    /* the task switch set CR0.TS */
+    f.edi = main_tss.edi;
+    f.esi = main_tss.esi;
+    f.ebp = main_tss.ebp;
+    f.esp = main_tss.esp;
+    f.ebx = main_tss.ebx;
+    f.edx = main_tss.edx;
+    f.ecx = main_tss.ecx;
+    f.eax = main_tss.eax;
+    f.vector = EXC_DOUBLE_FAULT;
+    f.err_code = 0;
+    f.eip = main_tss.eip;
+    f.cs = main_tss.cs;
+    f.eflags = main_tss.eflags;
+    if (exception_handlers[EXC_DOUBLE_FAULT]) {
+        exception_handlers[EXC_DOUBLE_FAULT](&f);
+    }
+    exception_panic(&f);
+    while (1) {
+        __asm__ volatile ("cli; hlt");
+    }
+}
+
+static void gdt_init(void) {
+    gdt_ptr_t ptr;
+
+    gdt_set(0, 0, 0, 0, 0);
+    gdt_set(1, 0, 0xFFFFF, 0x9A, 0xC);     /* ring 0 code, 4 GB, 32-bit */
+    gdt_set(2, 0, 0xFFFFF, 0x92, 0xC);     /* ring 0 data, 4 GB, 32-bit */
+    gdt_set(3, (uint32_t)&main_tss, sizeof(tss_t) - 1, 0x89, 0);
+    gdt_set(4, (uint32_t)&df_tss, sizeof(tss_t) - 1, 0x89, 0);
+
+    main_tss.ss0 = KERNEL_DS;
+    main_tss.iomap = sizeof(tss_t);
+
+    df_tss.eip = (uint32_t)double_fault_task;
+    df_tss.esp = (uint32_t)(df_stack + DF_STACK_SIZE);
+    df_tss.eflags = 0x2;                   /* interrupts stay off */
+    df_tss.cr3 = read_cr3();
+    df_tss.cs = KERNEL_CS;
+    df_tss.ds = df_tss.es = df_tss.fs = df_tss.gs = df_tss.ss = KERNEL_DS;
+    df_tss.iomap = sizeof(tss_t);
+
+    ptr.limit = sizeof(gdt) - 1;
+    ptr.base = (uint32_t)gdt;
+    __asm__ volatile ("lgdt %0\n\t"
+                      "ljmp %1, $1f\n"
+                      "1:\n\t"
+                      "movw %2, %%ax\n\t"
+                      "movw %%ax, %%ds\n\t"
+                      "movw %%ax, %%es\n\t"
+                      "movw %%ax, %%fs\n\t"
+                      "movw %%ax, %%gs\n\t"
+                      "movw %%ax, %%ss\n\t"
+                      "movw %3, %%ax\n\t"
+                      "ltr %%ax"
+                      : : "m"(ptr), "i"(KERNEL_CS), "i"(KERNEL_DS), "i"(MAIN_TSS)
+                      : "eax", "memory");
+}
+
+static void idt_set_gate(int vec, uint32_t handler, uint16_t sel) {
+    idt[vec].offset_lo = handler & 0xFFFF;
+    idt[vec].selector = sel;
+    idt[vec].zero = 0;
+    idt[vec].type_attr = IDT_INTERRUPT_GATE;
+    idt[vec].offset_hi = (handler >> 16) & 0xFFFF;
+}
+
+void idt_init(void) {
+    idt_ptr_t ptr;
+    int i;
+
+    gdt_init();
+
+    for (i = 0; i < IDT_ENTRIES; i++) {
+        idt_set_gate(i, isr_stub_table[i], KERNEL_CS);
+    }
+    /* #DF goes through a task gate: no offset, the TSS holds the entry */
+    idt_set_gate(EXC_DOUBLE_FAULT, 0, DF_TSS);
+    idt[EXC_DOUBLE_FAULT].type_attr = IDT_TASK_GATE;
+    for (i = 0; i < NUM_IRQS; i++) {
+        irq_handlers[i] = NULL;
+    }
+    for (i = 0; i < IRQ_BASE; i++) {
+        exception_handlers[i] = NULL;
+    }
+
+    ptr.limit = sizeof(idt) - 1;
+    ptr.base = (uint32_t)idt;
+    __asm__ volatile ("lidt %0" : : "m"(ptr));
+
+    pic_init(IRQ_BASE);
+}
+
+void irq_register(int irq, irq_handler_t handler) {
+    if (irq < 0 || irq >= NUM_IRQS) return;
+    irq_handlers[irq] = handler;
+    pic_unmask(irq);
+}
+
+void exception_register(int vector, exception_handler_t handler) {
+    if (vector < 0 || vector >= IRQ_BASE) return;
+    exception_handlers[vector] = handler;
+}
+
+void idt_set_page_dir(uint32_t cr3) {
+    df_tss.cr3 = cr3;
+}
+
+static void exception_panic(interrupt_frame_t *f) {
+    kprintf("\n[IDT] Exception 0x%08x (%s) err=0x%08x eip=0x%08x\n"
+            "[IDT] System halted\n",
+            f->vector, exception_names[f->vector], f->err_code, f->eip);
+    while (1) {
+        __asm__ volatile ("cli; hlt");
+    }
+}
+
+/* Called from isr_common with interrupts disabled */
+void isr_dispatch(interrupt_frame_t *f) {
+    if (f->vector < IRQ_BASE) {
+        if (exception_handlers[f->vector]) {
+            exception_handlers[f->vector](f);
+        } else {
+            exception_panic(f);
+        }
+        return;
+    }
+
+    int irq = f->vector - IRQ_BASE;
+    /* Acknowledge first: the handler may switch tasks and not return here
+       until the interrupted task is scheduled again. */
+    pic_eoi(irq);
+    if (irq_handlers[irq]) {
+        irq_handlers[irq]();
+    }
+}
@@ -0,0 +1,44 @@
+/* idt.h - Interrupt descriptor table, exceptions and IRQ dispatch */
+#ifndef IDT_H
+#define IDT_H
+
+#include "types.h"
+
+#define IRQ_BASE    32      /* PIC IRQ0 is remapped to this vector */
+#define NUM_IRQS    16
+
+#define IRQ_TIMER   0
+#define IRQ_COM1    4
+
+/* Register layout pushed by isr_common (see src/boot/isr.S) */
+typedef struct {
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;   /* pusha */
+    uint32_t vector;
+    uint32_t err_code;
+    uint32_t eip, cs, eflags;                          /* pushed by CPU */
+} interrupt_frame_t;
+
+typedef void (*irq_handler_t)(void);
+
+/* Exception handlers get the faulting frame; unhandled exceptions halt */
+typedef void (*exception_handler_t)(interrupt_frame_t *f);
+
+#define EXC_DEVICE_NOT_AVAILABLE 7   /* #NM: FPU/SSE use with CR0.TS set */
+#define EXC_DOUBLE_FAULT         8   /* #DF: runs as its own task, own stack */
+#define EXC_PAGE_FAULT           14  /* #PF: faulting address in CR2 */
+
+/* Load our GDT and TSSs, then build and load the IDT (exceptions 0-31,
+   IRQs 32-47) */
+void idt_init(void);
+
+/* Install a handler for a PIC line and unmask it */
+void irq_register(int irq, irq_handler_t handler);
+
+/* Install a handler for CPU exception vector (0-31) */
+void exception_register(int vector, exception_handler_t handler);
+
+/* Page directory the double-fault task switches to (the CPU loads CR3
+   from its TSS) */
+void idt_set_page_dir(uint32_t cr3);
+
+#endif
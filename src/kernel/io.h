@@ -4,6 +4,17 @@
 
 #include "types.h"
 
+#ifdef KACCHI_HOST
+/* Host build (make host): no ports, and nothing to mask interrupts against */
+static inline void outb(uint16_t port, uint8_t val) { (void)port; (void)val; }
+static inline uint8_t inb(uint16_t port) { (void)port; return 0; }
+static inline uint32_t irq_save(void) { return 0; }
+static inline void irq_restore(uint32_t flags) { (void)flags; }
+static inline void irq_enable(void) { }
+static inline void cpu_wait_irq(void) { }
+static inline int irq_enabled(void) { return 1; }
+#else
+
 static inline void outb(uint16_t port, uint8_t val) {
     __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
 }
@@ -14,4 +25,44 @@ static inline uint8_t inb(uint16_t port) {
     return ret;
 }
 
+#define EFLAGS_IF 0x200     /* interrupt-enable flag */
+
+/* Disable interrupts and return the previous EFLAGS */
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile ("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+/* Are interrupts enabled? (false in IRQ handlers and irq_save sections) */
+static inline int irq_enabled(void) {
+    uint32_t flags;
+    __asm__ volatile ("pushfl; popl %0" : "=r"(flags));
+    return (flags & EFLAGS_IF) != 0;
+}
+
+/* Restore EFLAGS (and thus IF) saved by irq_save() */
+static inline void irq_restore(uint32_t flags) {
+    __asm__ volatile ("pushl %0; popfl" : : "r"(flags) : "memory", "cc");
+}
+
+static inline void irq_enable(void) {
+    __asm__ volatile ("sti" : : : "memory");
+}
+
+/* Atomically enable interrupts and halt until one arrives, then disable
+   them again (sti only takes effect after the following instruction) */
+static inline void cpu_wait_irq(void) {
+    __asm__ volatile ("sti; hlt; cli" : : : "memory");
+}
+
+#endif
+
+/* Read the CPU time-stamp counter */
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,192 @@
+/* ipc.c - Message ports: bounded queues that hand heap buffers between tasks */
+#include "ipc.h"
+#include "io.h"
+#include "kprintf.h"
+#include "memory.h"
+#include "scheduler.h"
+#include "serial.h"
+
+typedef struct {
+    int owner;                  /* pid of the receiving task, -1 = free */
+    uint32_t gen;               /* bumped on close, so waiters notice reuse */
+    uint32_t head;              /* next slot to receive (free-running) */
+    uint32_t tail;              /* next slot to fill */
+    ipc_msg_t queue[IPC_QUEUE_LEN];
+    wait_queue_t rx_wait;       /* the owner, while the queue is empty */
+    wait_queue_t tx_wait;       /* senders, while the queue is full */
+    uint32_t sent;
+    uint32_t received;
+    uint32_t blocked_sends;     /* sends that had to wait for space */
+} ipc_port_t;
+
+static ipc_port_t ports[IPC_MAX_PORTS];
+
+void ipc_init(void) {
+    int i;
+    for (i = 0; i < IPC_MAX_PORTS; i++) {
+        ports[i].owner = -1;
+    }
+}
+
+static ipc_port_t* port_get(int port) {
+    if (port < 0 || port >= IPC_MAX_PORTS || ports[port].owner < 0) return NULL;
+    return &ports[port];
+}
+
+int ipc_port_create(void) {
+    uint32_t flags = irq_save();
+    int i;
+    for (i = 0; i < IPC_MAX_PORTS; i++) {
+        if (ports[i].owner < 0) break;
+    }
+    if (i == IPC_MAX_PORTS) {
+        irq_restore(flags);
+        return IPC_EINVAL;
+    }
+
+    ipc_port_t *p = &ports[i];
+    p->owner = sched_getpid();
+    p->head = 0;
+    p->tail = 0;
+    p->rx_wait.head = -1;
+    p->rx_wait.tail = -1;
+    p->tx_wait.head = -1;
+    p->tx_wait.tail = -1;
+    p->sent = 0;
+    p->received = 0;
+    p->blocked_sends = 0;
+    irq_restore(flags);
+    return i;
+}
+
+/* Called with interrupts disabled */
+static void port_close(ipc_port_t *p) {
+    /* Undelivered buffers belong to the port once sent */
+    while (p->head != p->tail) {
+        free(p->queue[p->head % IPC_QUEUE_LEN].data);
+        p->head++;
+    }
+    p->owner = -1;
+    p->gen++;
+    sched_wake_all(&p->rx_wait);
+    sched_wake_all(&p->tx_wait);
+}
+
+int ipc_port_destroy(int port) {
+    uint32_t flags = irq_save();
+    ipc_port_t *p = port_get(port);
+    if (!p || p->owner != sched_getpid()) {
+        irq_restore(flags);
+        return IPC_EINVAL;
+    }
+    port_close(p);
+    irq_restore(flags);
+    return IPC_OK;
+}
+
+void ipc_task_exit(int pid) {
+    uint32_t flags = irq_save();
+    int i;
+    for (i = 0; i < IPC_MAX_PORTS; i++) {
+        if (ports[i].owner == pid) port_close(&ports[i]);
+    }
+    irq_restore(flags);
+}
+
+int ipc_port_lookup(int pid) {
+    uint32_t flags = irq_save();
+    int i;
+    for (i = 0; i < IPC_MAX_PORTS; i++) {
+        if (ports[i].owner == pid) break;
+    }
+    irq_restore(flags);
+    return i < IPC_MAX_PORTS ? i : IPC_EINVAL;
+}
+
+/* Called with interrupts disabled */
+static int send(int port, uint32_t type, void *data, uint32_t len, int block) {
+    ipc_port_t *p = port_get(port);
+    if (!p) return IPC_EINVAL;
+
+    if (p->tail - p->head == IPC_QUEUE_LEN) {
+        uint32_t gen = p->gen;
+        if (!block) return IPC_EAGAIN;
+        p->blocked_sends++;
+        do {
+            sched_wait(&p->tx_wait);
+            /* the port may have been closed (and even reopened) meanwhile */
+            if (p->owner < 0 || p->gen != gen) return IPC_EINVAL;
+        } while (p->tail - p->head == IPC_QUEUE_LEN);
+    }
+
+    ipc_msg_t *m = &p->queue[p->tail % IPC_QUEUE_LEN];
+    m->from = sched_getpid();
+    m->type = type;
+    m->data = data;
+    m->len = len;
+    p->tail++;
+    p->sent++;
+
+    /* Hand the CPU straight to the receiver if it outranks us */
+    sched_wake_one(&p->rx_wait);
+    return IPC_OK;
+}
+
+/* Called with interrupts disabled */
+static int recv(int port, ipc_msg_t *msg, int block) {
+    ipc_port_t *p = port_get(port);
+    if (!p || p->owner != sched_getpid()) return IPC_EINVAL;
+
+    uint32_t gen = p->gen;
+    while (p->head == p->tail) {
+        if (!block) return IPC_EAGAIN;
+        sched_wait(&p->rx_wait);
+        if (p->owner < 0 || p->gen != gen) return IPC_EINVAL;
+    }
+
+    *msg = p->queue[p->head % IPC_QUEUE_LEN];
+    p->head++;
+    p->received++;
+
+    sched_wake_one(&p->tx_wait);
+    return IPC_OK;
+}
+
+int ipc_send(int port, uint32_t type, void *data, uint32_t len) {
+    uint32_t flags = irq_save();
+    int ret = send(port, type, data, len, 1);
+    irq_restore(flags);
+    return ret;
+}
+
+int ipc_try_send(int port, uint32_t type, void *data, uint32_t len) {
+    uint32_t flags = irq_save();
+    int ret = send(port, type, data, len, 0);
+    irq_restore(flags);
+    return ret;
+}
+
+int ipc_recv(int port, ipc_msg_t *msg) {
+    uint32_t flags = irq_save();
+    int ret = recv(port, msg, 1);
+    irq_restore(flags);
+    return ret;
+}
+
+int ipc_try_recv(int port, ipc_msg_t *msg) {
+    uint32_t flags = irq_save();
+    int ret = recv(port, msg, 0);
+    irq_restore(flags);
+    return ret;
+}
+
+void ipc_stats(void) {
+    int i;
+    serial_puts("PORT\tOWNER\tQUEUED\tSENT\tRECV\tBLOCKED\n");
+    for (i = 0; i < IPC_MAX_PORTS; i++) {
+        ipc_port_t *p = &ports[i];
+        if (p->owner < 0) continue;
+        kprintf("%d\t%d\t%u\t%u\t%u\t%u\n", i, p->owner, p->tail - p->head,
+                p->sent, p->received, p->blocked_sends);
+    }
+}
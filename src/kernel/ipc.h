@@ -0,0 +1,58 @@
+/* ipc.h - Message ports: bounded queues that hand heap buffers between tasks */
+#ifndef IPC_H
+#define IPC_H
+
+#include "types.h"
+
+#define IPC_MAX_PORTS  32
+#define IPC_QUEUE_LEN  16       /* messages per port (power of two) */
+
+/* Return codes */
+#define IPC_OK       0
+#define IPC_EINVAL  -1          /* no such port, or not its owner */
+#define IPC_EAGAIN  -2          /* queue full (send) or empty (receive) */
+
+/* A message is a small header plus an optional heap buffer. The buffer is
+   never copied: ipc_send() passes the pointer, and from then on it belongs
+   to whoever receives the message, who must free() it. */
+typedef struct {
+    int from;               /* sender pid */
+    uint32_t type;          /* caller-defined tag */
+    void *data;             /* malloc()ed payload or NULL */
+    uint32_t len;
+} ipc_msg_t;
+
+void ipc_init(void);
+
+/* Create a port owned by the calling task. Only the owner receives from
+   it; any task may send. Returns the port id or IPC_EINVAL if none left. */
+int ipc_port_create(void);
+
+/* Close a port: queued buffers are freed and blocked tasks return
+   IPC_EINVAL. Only the owner may destroy a port. */
+int ipc_port_destroy(int port);
+
+/* First port owned by pid, or IPC_EINVAL */
+int ipc_port_lookup(int pid);
+
+/* Close every port pid owns, as ipc_port_destroy() would. A port lives no
+   longer than its owner: exit_task() calls this. */
+void ipc_task_exit(int pid);
+
+/* Queue a message, blocking while the port is full. On IPC_OK, data now
+   belongs to the receiver; on failure the caller still owns it. */
+int ipc_send(int port, uint32_t type, void *data, uint32_t len);
+
+/* Like ipc_send(), but returns IPC_EAGAIN instead of blocking */
+int ipc_try_send(int port, uint32_t type, void *data, uint32_t len);
+
+/* Dequeue the oldest message into msg, blocking while the port is empty */
+int ipc_recv(int port, ipc_msg_t *msg);
+
+/* Like ipc_recv(), but returns IPC_EAGAIN instead of blocking */
+int ipc_try_recv(int port, ipc_msg_t *msg);
+
+/* Print every open port */
+void ipc_stats(void);
+
+#endif
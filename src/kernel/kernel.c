@@ -1,50 +1,80 @@
 /* kernel.c - Main kernel with scheduler, memory manager, and process manager */
 #include "types.h"
+#include "io.h"
+#include "klog.h"
+#include "kprintf.h"
 #include "serial.h"
 #include "string.h"
 #include "scheduler.h"
 #include "memory.h"
+#include "pmm.h"
+#include "slab.h"
+#include "multiboot.h"
+#include "paging.h"
 #include "process.h"
+#include "idt.h"
+#include "pit.h"
+#include "bench.h"
+#include "cpu.h"
+#include "fpu.h"
+#include "ipc.h"
+#include "prof.h"
 
 #define MAX_INPUT 128
 
-/* Simple utility to print unsigned integer */
-static void print_u32(uint32_t v) {
-    char buf[12];
-    int pos = 0;
-    if (v == 0) { serial_putc('0'); return; }
-    while (v) {
-        buf[pos++] = '0' + (v % 10);
-        v /= 10;
+/* QEMU isa-debug-exit device (make bench); QEMU exits with (code << 1) | 1 */
+#define QEMU_EXIT_PORT 0xF4
+
+/* Parse a decimal argument; stops at the first non-digit */
+static uint32_t parse_u32(const char *s) {
+    uint32_t v = 0;
+    while (*s >= '0' && *s <= '9') {
+        v = v * 10 + (*s++ - '0');
     }
-    while (pos--) serial_putc(buf[pos]);
+    return v;
+}
+
+/* Is word one of the space-separated tokens of the multiboot command line? */
+static int cmdline_has(multiboot_info_t *mbi, const char *word) {
+    size_t n = strlen(word);
+    const char *p;
+
+    if (!mbi || !(mbi->flags & MULTIBOOT_INFO_CMDLINE) || !mbi->cmdline) return 0;
+    p = (const char*)mbi->cmdline;
+    while (*p) {
+        while (*p == ' ') p++;
+        const char *tok = p;
+        while (*p && *p != ' ') p++;
+        if ((size_t)(p - tok) == n && strncmp(tok, word, n) == 0) return 1;
+    }
+    return 0;
 }
 
 /* Example task A: prints a message and yields */
 void task_a(void) {
     while (1) {
-        serial_puts("[task A] running (ticks=");
-        print_u32(sched_get_ticks());
-        serial_puts(")\n");
-        sleep_ticks(2);
+        klog("[task A] running (ticks=%u)\n", sched_get_ticks());
+        sleep_ticks(2 * SCHED_HZ);
     }
 }
 
 /* Example task B: prints and yields */
 void task_b(void) {
     while (1) {
-        serial_puts("[task B] hello\n");
-        sleep_ticks(3);
+        klog("[task B] hello\n");
+        sleep_ticks(3 * SCHED_HZ);
     }
 }
 
-void kmain(void) {
+
+void kmain(uint32_t magic, multiboot_info_t *mbi) {
     char input[MAX_INPUT];
     int pos = 0;
     int should_exit = 0;
     
     /* Initialize hardware and managers */
     serial_init();
+    idt_init();
 
     /* Welcome */
     serial_puts("\n");
@@ -54,25 +84,60 @@ void kmain(void) {
     serial_puts("Hello from kacchiOS!\n");
     serial_puts("Initializing managers...\n\n");
 
-    /* Initialize memory manager (64KB heap at 0x00100000) */
-    mem_init(0x00100000, 65536);
+    /* Probe the CPU, then pick memcpy/memset kernels to match it */
+    cpu_init();
+    string_init();
+    prof_init();
+
+    /* Initialize the page-frame allocator from the multiboot memory map,
+       then place the heap on top of it (it grows a page range at a time) */
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC) {
+        klog("[BOOT] No multiboot info, assuming 4 MB of RAM\n");
+        mbi = NULL;
+    }
+    /* Read the command line before the PMM hands out the memory it is in */
+    int bench_mode = cmdline_has(mbi, "bench");
+    pmm_init(mbi);
+    /* Identity-map all of RAM; task stacks get guard pages from here on */
+    paging_init();
+    mem_init(pmm_alloc_contig(MEM_INITIAL_PAGES, 1), MEM_INITIAL_PAGES * PAGE_SIZE);
 
     /* Initialize process manager */
     proc_init();
+    ipc_init();
 
     /* Initialize scheduler and create demo tasks */
     sched_init();
-    create_task(task_a, 1);
-    create_task(task_b, 1);
+    fpu_init();
+    klog_start();
+    if (!bench_mode) {
+        create_task(task_a, 1);
+        create_task(task_b, 1);
+    }
+
+    /* Start the timer interrupt: from here on tasks are preempted */
+    irq_register(IRQ_TIMER, sched_tick);
+    pit_init(SCHED_HZ);
+    irq_register(IRQ_COM1, serial_irq);
+    serial_enable_irq();
+    irq_enable();
+
+    if (bench_mode) {
+        bench_suite();
+        klog_flush();
+        serial_flush();
+        outb(QEMU_EXIT_PORT, 0);
+        serial_puts("No isa-debug-exit device; continuing to the CLI\n");
+    }
 
     serial_puts("Running null process (CLI). Type 'ps', 'plist', 'mem', 'memdump', 'help'\n");
 
-    /* Main loop - the null process (cooperative) */
+    /* Main loop - the null process */
     while (!should_exit) {
         serial_puts("kacchiOS> ");
         pos = 0;
 
-        /* Read input line */
+        /* Read input line; serial_getc() blocks, letting other tasks run */
         while (1) {
             char c = serial_getc();
             if (c == '\r' || c == '\n') {
@@ -95,21 +160,58 @@ void kmain(void) {
                 proc_list();
             } else if (strcmp(input, "mem") == 0) {
                 mem_stats();
+                pmm_stats();
             } else if (strcmp(input, "memdump") == 0) {
                 mem_dump();
             } else if (strcmp(input, "clear") == 0) {
                 serial_clear();
             } else if (strcmp(input, "yield") == 0) {
                 yield();
+            } else if (strcmp(input, "bench timer") == 0) {
+                bench_timer();
+            } else if (strcmp(input, "bench alloc") == 0) {
+                bench_alloc();
+            } else if (strcmp(input, "bench slab") == 0) {
+                bench_slab();
+            } else if (strcmp(input, "bench string") == 0) {
+                bench_string();
+            } else if (strcmp(input, "bench serial") == 0) {
+                bench_serial();
+            } else if (strcmp(input, "bench switch") == 0) {
+                bench_switch();
+            } else if (strcmp(input, "bench ipc") == 0) {
+                bench_ipc();
+            } else if (strcmp(input, "bench tlb") == 0) {
+                bench_tlb();
+            } else if (strcmp(input, "ipc") == 0) {
+                ipc_stats();
+            } else if (strcmp(input, "baud") == 0) {
+                kprintf("Baud rate: %u\n", serial_get_baud());
+            } else if (strncmp(input, "baud ", 5) == 0) {
+                if (serial_set_baud(parse_u32(input + 5)) == 0) {
+                    serial_puts("Baud rate set; switch the terminal to match\n");
+                } else {
+                    serial_puts("Baud rate must divide 115200\n");
+                }
+            } else if (strcmp(input, "perf") == 0) {
+                prof_report();
+            } else if (strcmp(input, "perf reset") == 0) {
+                prof_reset();
+            } else if (strcmp(input, "dmesg") == 0) {
+                klog_dmesg();
+            } else if (strcmp(input, "fpu") == 0) {
+                fpu_stats();
+            } else if (strcmp(input, "paging") == 0) {
+                paging_stats();
+            } else if (strcmp(input, "slab") == 0) {
+                kmem_cache_stats();
             } else if (strcmp(input, "exit") == 0) {
                 serial_puts("Shutting down kacchiOS...\n");
                 should_exit = 1;
             } else if (strcmp(input, "help") == 0) {
-                serial_puts("Commands: ps, plist, mem, memdump, clear, yield, exit, help\n");
+                serial_puts("Commands: ps, plist, mem, memdump, dmesg, perf [reset], clear, yield, slab, fpu, paging, bench timer, bench alloc, bench slab, bench string, bench serial, bench switch, bench ipc, bench tlb, ipc, baud [rate], exit, help\n");
             } else {
-                serial_puts("You typed: ");
-                serial_puts(input);
-                serial_puts("\n");
+                kprintf("You typed: %s\n", input);
             }
         }
 
@@ -118,5 +220,7 @@ void kmain(void) {
     }
 
     serial_puts("kacchiOS exiting...\n");
+    klog_flush();
+    serial_flush();
     return;
 }
\ No newline at end of file
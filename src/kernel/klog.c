@@ -0,0 +1,156 @@
+/* klog.c - Lock-free kernel log ring with a deferred console drainer
+ *
+ * Writers claim a slot with one atomic increment of klog_head and never
+ * wait: when the ring is full the oldest record is overwritten. Each slot
+ * carries a commit word (sequence + 1, or 0 while being written) that the
+ * reader checks before and after copying, so a torn or overwritten record
+ * is detected rather than printed. The console side runs in a low-priority
+ * task, so logging from a hot path costs a format and a copy, not serial
+ * I/O.
+ */
+#include "klog.h"
+#include "io.h"
+#include "kprintf.h"
+#include "scheduler.h"
+
+typedef struct {
+    volatile uint32_t commit;   /* seq + 1 once complete, 0 while written */
+    uint32_t tick;
+    char text[KLOG_MSG_LEN];
+} klog_rec_t;
+
+static klog_rec_t ring[KLOG_RECORDS];
+static volatile uint32_t klog_head = 0;     /* next sequence to claim */
+static uint32_t console_seq = 0;            /* next sequence to print */
+static volatile uint32_t dropped = 0;
+static volatile int draining = 0;           /* console_seq owner */
+static int started = 0;
+static wait_queue_t klog_wait = WAIT_QUEUE_INIT;
+
+#define barrier() __asm__ volatile ("" : : : "memory")
+
+/* Copy record seq out of the ring: 1 = copied, 0 = still being written,
+   -1 = already overwritten by a newer record */
+static int read_record(uint32_t seq, klog_rec_t *out) {
+    klog_rec_t *r = &ring[seq & (KLOG_RECORDS - 1)];
+    uint32_t c = r->commit;
+    if (c != seq + 1) {
+        return (c == 0 || (int32_t)(c - (seq + 1)) < 0) ? 0 : -1;
+    }
+    barrier();
+    *out = *r;
+    barrier();
+    return r->commit == seq + 1 ? 1 : -1;
+}
+
+static void print_record(const klog_rec_t *r) {
+    kprintf("[%6u] %s", r->tick, r->text);
+}
+
+/* Print new records to the console. Returns 0 when it stopped at a record
+   that is still being written. Only one context drains at a time; a
+   second caller returns immediately. */
+static int drain(void) {
+    klog_rec_t rec;
+    int done = 1;
+
+    if (__atomic_exchange_n(&draining, 1, __ATOMIC_ACQUIRE)) return 1;
+    while (console_seq != klog_head) {
+        uint32_t head = klog_head;
+        if (head - console_seq > KLOG_RECORDS) {
+            dropped += head - console_seq - KLOG_RECORDS;
+            console_seq = head - KLOG_RECORDS;
+        }
+        int r = read_record(console_seq, &rec);
+        if (r == 0) {
+            done = 0;
+            break;
+        }
+        if (r > 0) {
+            print_record(&rec);
+        } else {
+            dropped++;
+        }
+        console_seq++;
+    }
+    __atomic_store_n(&draining, 0, __ATOMIC_RELEASE);
+    return done;
+}
+
+void klog(const char *fmt, ...) {
+    va_list ap;
+    uint32_t seq = __atomic_fetch_add(&klog_head, 1, __ATOMIC_RELAXED);
+    klog_rec_t *r = &ring[seq & (KLOG_RECORDS - 1)];
+
+    r->commit = 0;
+    barrier();
+    r->tick = sched_get_ticks();
+    va_start(ap, fmt);
+    int len = kvsnprintf(r->text, KLOG_MSG_LEN, fmt, ap);
+    va_end(ap);
+    if (len >= KLOG_MSG_LEN) {
+        r->text[KLOG_MSG_LEN - 2] = '\n';     /* truncated: keep the line break */
+    }
+    barrier();
+    r->commit = seq + 1;
+
+    if (started) {
+        sched_wake_all(&klog_wait);
+    } else {
+        drain();
+    }
+}
+
+static void klog_drain_task(void) {
+    while (1) {
+        uint32_t flags = irq_save();
+        while (console_seq == klog_head) {
+            sched_wait(&klog_wait);
+        }
+        irq_restore(flags);
+        if (!drain()) {
+            /* a writer was preempted mid-record; let it finish */
+            sleep_ticks(1);
+        }
+    }
+}
+
+void klog_start(void) {
+    if (create_task(klog_drain_task, KLOG_PRIORITY) >= 0) {
+        started = 1;
+    }
+}
+
+/* Ticks klog_flush() waits at most for the drainer or a preempted
+   writer before giving up on the rest */
+#define KLOG_FLUSH_TICKS 100
+
+void klog_flush(void) {
+    int waited;
+    for (waited = 0; waited < KLOG_FLUSH_TICKS; waited++) {
+        /* Returns at once if the drainer task holds console_seq */
+        drain();
+        if (console_seq == klog_head) return;
+        if (!started || !irq_enabled()) return;
+        sleep_ticks(1);     /* let the drainer (lowest priority) finish */
+    }
+}
+
+void klog_dmesg(void) {
+    klog_rec_t rec;
+    uint32_t head = klog_head;
+    uint32_t seq = head > KLOG_RECORDS ? head - KLOG_RECORDS : 0;
+    uint32_t shown = 0;
+
+    for (; seq != head; seq++) {
+        if (read_record(seq, &rec) > 0) {
+            print_record(&rec);
+            shown++;
+        }
+    }
+    kprintf("-- %u records shown, %u logged, %u dropped --\n", shown, head, dropped);
+}
+
+uint32_t klog_dropped(void) {
+    return dropped;
+}
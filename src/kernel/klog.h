@@ -0,0 +1,31 @@
+/* klog.h - Kernel log ring buffer */
+#ifndef KLOG_H
+#define KLOG_H
+
+#include "types.h"
+
+#define KLOG_RECORDS 256        /* ring slots (power of two) */
+#define KLOG_MSG_LEN 116        /* text bytes per record, including NUL */
+#define KLOG_PRIORITY 0         /* drainer task priority (lowest) */
+
+/* Append a kprintf-formatted record stamped with the current tick. Never
+   blocks on the console, so it is safe from IRQ handlers. Text beyond
+   KLOG_MSG_LEN - 1 is cut off. */
+void klog(const char *fmt, ...);
+
+/* Start the drainer task that copies new records to COM1. Before this,
+   klog() writes each record to the console itself. */
+void klog_start(void);
+
+/* Write any records the console has not seen yet (e.g. before exit).
+   If the drainer task is mid-batch, sleeps until it is done (up to about
+   a second) so nothing logged before the call is left unprinted. */
+void klog_flush(void);
+
+/* Print every record still in the ring */
+void klog_dmesg(void);
+
+/* Records overwritten before they reached the console */
+uint32_t klog_dropped(void);
+
+#endif
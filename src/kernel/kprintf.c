@@ -0,0 +1,140 @@
+/* kprintf.c - printf-style formatting for the kernel */
+#include "kprintf.h"
+#include "serial.h"
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+} out_t;
+
+static void out_c(out_t *o, char c) {
+    if (o->len + 1 < o->size) o->buf[o->len] = c;
+    o->len++;
+}
+
+static void out_pad(out_t *o, char c, int n) {
+    while (n-- > 0) out_c(o, c);
+}
+
+/* Emit a converted field: optional sign, then digits/text, padded */
+static void out_field(out_t *o, const char *s, int n, char sign,
+                      int width, int left, char pad) {
+    int fill = width - n - (sign ? 1 : 0);
+    if (!left && pad == ' ') out_pad(o, ' ', fill);
+    if (sign) out_c(o, sign);
+    if (!left && pad == '0') out_pad(o, '0', fill);
+    while (n--) out_c(o, *s++);
+    if (left) out_pad(o, ' ', fill);
+}
+
+static int utoa(uint32_t v, int base, char *tmp) {
+    char rev[12];
+    int n = 0, i;
+    do {
+        uint32_t d = v % base;
+        rev[n++] = d < 10 ? '0' + d : 'a' + d - 10;
+        v /= base;
+    } while (v);
+    for (i = 0; i < n; i++) tmp[i] = rev[n - 1 - i];
+    return n;
+}
+
+int kvsnprintf(char *buf, size_t size, const char *fmt, va_list ap) {
+    out_t o;
+    char tmp[12];
+    o.buf = buf;
+    o.size = size;
+    o.len = 0;
+
+    while (*fmt) {
+        if (*fmt != '%') {
+            out_c(&o, *fmt++);
+            continue;
+        }
+        fmt++;
+
+        int left = 0;
+        char pad = ' ';
+        int width = 0;
+        for (;; fmt++) {
+            if (*fmt == '-') left = 1;
+            else if (*fmt == '0') pad = '0';
+            else break;
+        }
+        if (left) pad = ' ';
+        while (*fmt >= '0' && *fmt <= '9') {
+            width = width * 10 + (*fmt++ - '0');
+        }
+
+        switch (*fmt) {
+            case 'd': {
+                int v = va_arg(ap, int);
+                uint32_t u = v < 0 ? 0u - (uint32_t)v : (uint32_t)v;
+                out_field(&o, tmp, utoa(u, 10, tmp), v < 0 ? '-' : 0, width, left, pad);
+                break;
+            }
+            case 'u':
+                out_field(&o, tmp, utoa(va_arg(ap, uint32_t), 10, tmp), 0, width, left, pad);
+                break;
+            case 'x':
+                out_field(&o, tmp, utoa(va_arg(ap, uint32_t), 16, tmp), 0, width, left, pad);
+                break;
+            case 'p': {
+                uint32_t v = (uint32_t)va_arg(ap, void*);
+                char hex[10];
+                int i;
+                hex[0] = '0';
+                hex[1] = 'x';
+                for (i = 0; i < 8; i++) {
+                    uint32_t d = (v >> (28 - 4 * i)) & 0xF;
+                    hex[2 + i] = d < 10 ? '0' + d : 'a' + d - 10;
+                }
+                out_field(&o, hex, 10, 0, width, left, ' ');
+                break;
+            }
+            case 'c':
+                tmp[0] = (char)va_arg(ap, int);
+                out_field(&o, tmp, 1, 0, width, left, ' ');
+                break;
+            case 's': {
+                const char *s = va_arg(ap, const char*);
+                int n = 0;
+                if (!s) s = "(null)";
+                while (s[n]) n++;
+                out_field(&o, s, n, 0, width, left, ' ');
+                break;
+            }
+            case '%':
+                out_c(&o, '%');
+                break;
+            case '\0':
+                continue;       /* lone '%' at the end */
+            default:
+                out_c(&o, '%');
+                out_c(&o, *fmt);
+                break;
+        }
+        fmt++;
+    }
+    if (size > 0) buf[o.len < size ? o.len : size - 1] = '\0';
+    return (int)o.len;
+}
+
+int ksnprintf(char *buf, size_t size, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = kvsnprintf(buf, size, fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+int kprintf(const char *fmt, ...) {
+    char buf[KPRINTF_BUF];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = kvsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    serial_write(buf, n < KPRINTF_BUF ? (size_t)n : KPRINTF_BUF - 1);
+    return n;
+}
@@ -0,0 +1,23 @@
+/* kprintf.h - Formatted output */
+#ifndef KPRINTF_H
+#define KPRINTF_H
+
+#include "types.h"
+#include "stdarg.h"
+
+/* Longest line kprintf() writes in one go; the rest is cut off */
+#define KPRINTF_BUF 256
+
+/* Conversions: %d %u %x %c %s %p %%, each with an optional '-' (left
+   justify) or '0' (zero pad) flag and a minimum field width. %p prints
+   0x followed by eight hex digits. */
+
+/* Format into buf (always NUL-terminated when size > 0). Returns the
+   length the full output would have had. */
+int kvsnprintf(char *buf, size_t size, const char *fmt, va_list ap);
+int ksnprintf(char *buf, size_t size, const char *fmt, ...);
+
+/* Format into a stack buffer and send it to COM1 with one serial_write() */
+int kprintf(const char *fmt, ...);
+
+#endif
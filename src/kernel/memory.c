@@ -1,63 +1,169 @@
-/* memory.c - Heap allocation with free-list and coalescing */
+/* memory.c - Heap allocation with size-class caches, free-list and coalescing */
 #include "memory.h"
+#include "io.h"
+#include "pmm.h"
+#include "prof.h"
+#include "klog.h"
+#include "kprintf.h"
 #include "serial.h"
 #include "string.h"
 
 #define HEAP_ALIGN 8
-#define MIN_ALLOC 16
+#define MEM_MAX_REGIONS 16
+#define HEAP_GROW_PAGES 16      /* grow by at least 64 KB at a time */
 
+/* Block states */
+#define BLK_USED   0
+#define BLK_FREE   1
+#define BLK_CACHED 2    /* freed small block parked on its size-class list */
+
+/* Boundary-tag block layout:
+     [mem_block_t header][payload ...][uint32_t footer = size]
+   Free blocks keep their free-list links at the start of the payload, and
+   the footer lets free() find the previous physical block in O(1). The
+   heap is bracketed by a used prologue block and a zero-size used
+   epilogue header, so coalescing never needs bounds checks. */
 typedef struct {
-    uint32_t size;      /* size of this block (including header) */
-    int free;           /* 1 = free, 0 = allocated */
-    struct {
-        void *prev;
-        void *next;
-    } list;
+    uint32_t size;      /* size of this block (header, payload and footer) */
+    uint16_t free;      /* BLK_USED, BLK_FREE or BLK_CACHED */
+    int16_t cls;        /* size class index, -1 for first-fit blocks */
 } mem_block_t;
 
+/* Explicit free-list links, stored in the payload of a free block */
+typedef struct free_links {
+    mem_block_t *prev;
+    mem_block_t *next;
+} free_links_t;
+
+#define FOOTER_SIZE   sizeof(uint32_t)
+#define BLOCK_OVERHEAD (sizeof(mem_block_t) + FOOTER_SIZE)
+#define MIN_BLOCK \
+    ((sizeof(mem_block_t) + sizeof(free_links_t) + FOOTER_SIZE + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1))
+#define PROLOGUE_SIZE ((BLOCK_OVERHEAD + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1))
+
+/* Size-class cache entry, stored in the payload of a cached block */
+typedef struct class_node {
+    struct class_node *next;
+} class_node_t;
+
+typedef struct {
+    class_node_t *head;     /* cached blocks ready for reuse */
+    uint32_t hits;          /* served from the cache */
+    uint32_t misses;        /* carved from the first-fit heap */
+    uint32_t in_use;        /* blocks of this class handed out */
+    uint32_t cached;        /* blocks parked on head */
+} size_class_t;
+
+/* A contiguous piece of heap bracketed by its own prologue and epilogue.
+   The heap starts as one region and grows by extending the last region
+   with the frames right after it, or by adding a new region. */
+typedef struct {
+    uint32_t start;
+    uint32_t end;               /* exclusive; the epilogue sits just below */
+    mem_block_t *first;         /* first block after the prologue */
+} mem_region_t;
+
 static uint32_t heap_start = 0;
 static uint32_t heap_size = 0;
 static uint32_t heap_used = 0;
-static mem_block_t *free_list = NULL;
+static mem_region_t regions[MEM_MAX_REGIONS];
+static int region_count = 0;
+static mem_block_t *free_list = NULL;      /* free blocks only, LIFO order */
+static size_class_t classes[MEM_NUM_CLASSES];
 
-static void print_u32(uint32_t v) {
-    char buf[12];
-    int pos = 0;
-    if (v == 0) { serial_putc('0'); return; }
-    while (v) {
-        buf[pos++] = '0' + (v % 10);
-        v /= 10;
-    }
-    while (pos--) serial_putc(buf[pos]);
+/* ---- Boundary tags ---- */
+
+static free_links_t* links(mem_block_t *blk) {
+    return (free_links_t*)(blk + 1);
 }
 
-static void print_hex(uint32_t v) {
-    serial_puts("0x");
-    int i;
-    for (i = 7; i >= 0; i--) {
-        uint8_t nibble = (v >> (i * 4)) & 0xF;
-        serial_putc(nibble < 10 ? '0' + nibble : 'a' + nibble - 10);
-    }
+static void set_footer(mem_block_t *blk) {
+    *(uint32_t*)((uint8_t*)blk + blk->size - FOOTER_SIZE) = blk->size;
+}
+
+static mem_block_t* next_block(mem_block_t *blk) {
+    return (mem_block_t*)((uint8_t*)blk + blk->size);
+}
+
+static mem_block_t* prev_block(mem_block_t *blk) {
+    uint32_t prev_size = *(uint32_t*)((uint8_t*)blk - FOOTER_SIZE);
+    return (mem_block_t*)((uint8_t*)blk - prev_size);
+}
+
+/* ---- Explicit free list ---- */
+
+static void fl_insert(mem_block_t *blk) {
+    links(blk)->prev = NULL;
+    links(blk)->next = free_list;
+    if (free_list) links(free_list)->prev = blk;
+    free_list = blk;
+}
+
+static void fl_remove(mem_block_t *blk) {
+    mem_block_t *prev = links(blk)->prev;
+    mem_block_t *next = links(blk)->next;
+    if (prev) links(prev)->next = next;
+    else free_list = next;
+    if (next) links(next)->prev = prev;
+}
+
+static void set_epilogue(uint32_t end) {
+    mem_block_t *epilogue = (mem_block_t*)(end - sizeof(mem_block_t));
+    epilogue->size = 0;
+    epilogue->free = BLK_USED;
+    epilogue->cls = -1;
+}
+
+/* Lay out [start, end) as a new region holding one free block */
+static void region_add(uint32_t start, uint32_t end) {
+    /* Align the region so every payload is HEAP_ALIGN-aligned */
+    start = (start + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+    end &= ~(HEAP_ALIGN - 1);
+
+    /* Prologue: a permanently used block at the bottom of the region */
+    mem_block_t *prologue = (mem_block_t*)start;
+    prologue->size = PROLOGUE_SIZE;
+    prologue->free = BLK_USED;
+    prologue->cls = -1;
+    set_footer(prologue);
+
+    /* Epilogue: a zero-size used header at the top of the region */
+    set_epilogue(end);
+
+    /* Everything in between is one free block */
+    mem_block_t *first = next_block(prologue);
+    first->size = end - sizeof(mem_block_t) - (uint32_t)first;
+    first->free = BLK_FREE;
+    first->cls = -1;
+    set_footer(first);
+    fl_insert(first);
+
+    regions[region_count].start = start;
+    regions[region_count].end = end;
+    regions[region_count].first = first;
+    region_count++;
+    heap_size += end - start;
 }
 
 void mem_init(uint32_t start, uint32_t size) {
     heap_start = start;
-    heap_size = size;
+    heap_size = 0;
     heap_used = 0;
+    free_list = NULL;
+    region_count = 0;
+
+    int c;
+    for (c = 0; c < MEM_NUM_CLASSES; c++) {
+        classes[c].head = NULL;
+        classes[c].hits = 0;
+        classes[c].misses = 0;
+        classes[c].in_use = 0;
+        classes[c].cached = 0;
+    }
 
-    /* Initialize first block: entire heap is free */
-    mem_block_t *first = (mem_block_t*)heap_start;
-    first->size = heap_size;
-    first->free = 1;
-    first->list.prev = NULL;
-    first->list.next = NULL;
-    free_list = first;
+    region_add(start, start + size);
 
-    serial_puts("[MEM] Initialized at ");
-    print_hex(heap_start);
-    serial_puts(" size=");
-    print_u32(heap_size);
-    serial_puts("\n");
+    klog("[MEM] Initialized at 0x%08x size=%u\n", heap_start, heap_size);
 }
 
 /* Align size up to HEAP_ALIGN boundary */
@@ -65,87 +171,257 @@ static size_t align_up(size_t sz) {
     return (sz + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
 }
 
-/* Try to coalesce with next block if both are free */
+/* Size class serving a request, or -1 for the first-fit path */
+static int size_class(size_t size) {
+    if (size > MEM_CLASS_MAX) return -1;
+    if (size <= MEM_CLASS_MIN) return 0;
+    /* ceil(log2(size)) - log2(MEM_CLASS_MIN) */
+    return (32 - __builtin_clz(size - 1)) - 4;
+}
+
+static uint32_t class_size(int cls) {
+    return MEM_CLASS_MIN << cls;
+}
+
+/* Merge a newly freed block with free physical neighbours and put the
+   result on the free list. O(1) thanks to the boundary tags. */
 static void coalesce(mem_block_t *blk) {
-    if (!blk) return;
-    
-    mem_block_t *next = (mem_block_t*)blk->list.next;
-    if (next && next->free) {
-        /* Merge blk with next */
+    mem_block_t *next = next_block(blk);
+    if (next->free == BLK_FREE) {
+        fl_remove(next);
         blk->size += next->size;
-        blk->list.next = next->list.next;
-        if (next->list.next) {
-            ((mem_block_t*)next->list.next)->list.prev = blk;
-        }
     }
 
-    /* Also try to coalesce with previous */
-    mem_block_t *prev = (mem_block_t*)blk->list.prev;
-    if (prev && prev->free) {
+    mem_block_t *prev = prev_block(blk);
+    if (prev->free == BLK_FREE) {
+        fl_remove(prev);
         prev->size += blk->size;
-        prev->list.next = blk->list.next;
-        if (blk->list.next) {
-            ((mem_block_t*)blk->list.next)->list.prev = prev;
-        }
+        blk = prev;
     }
-}
 
-void* malloc(size_t size) {
-    if (size == 0) return NULL;
-    if (!heap_start) return NULL;
-
-    /* Required size: block header + payload, aligned */
-    size_t req = align_up(sizeof(mem_block_t) + size);
-    if (req < MIN_ALLOC) req = MIN_ALLOC;
+    set_footer(blk);
+    fl_insert(blk);
+}
 
-    /* First-fit: find first free block large enough */
+/* First-fit allocation of req bytes (overhead included). Only free blocks
+   are visited. */
+static mem_block_t* heap_alloc(size_t req) {
     mem_block_t *blk = free_list;
     while (blk) {
-        if (blk->free && blk->size >= req) {
-            /* Found suitable block. Split if too large. */
-            if (blk->size > req + MIN_ALLOC) {
-                /* Create new free block from remainder */
-                mem_block_t *new_blk = (mem_block_t*)((uint8_t*)blk + req);
-                new_blk->size = blk->size - req;
-                new_blk->free = 1;
-                new_blk->list.prev = blk;
-                new_blk->list.next = blk->list.next;
-                if (blk->list.next) {
-                    ((mem_block_t*)blk->list.next)->list.prev = new_blk;
-                }
-                blk->list.next = new_blk;
+        if (blk->size >= req) {
+            fl_remove(blk);
+            /* Found suitable block. Split if the remainder is usable. */
+            if (blk->size >= req + MIN_BLOCK) {
+                mem_block_t *rest = (mem_block_t*)((uint8_t*)blk + req);
+                rest->size = blk->size - req;
+                rest->free = BLK_FREE;
+                rest->cls = -1;
+                set_footer(rest);
+                fl_insert(rest);
                 blk->size = req;
             }
-            
-            /* Mark as allocated and return payload */
-            blk->free = 0;
-            heap_used += req;
-            return (void*)((uint8_t*)blk + sizeof(mem_block_t));
+
+            /* Mark as allocated */
+            blk->free = BLK_USED;
+            set_footer(blk);
+            heap_used += blk->size;
+            return blk;
         }
-        blk = (mem_block_t*)blk->list.next;
+        blk = links(blk)->next;
     }
 
     return NULL; /* Out of memory */
 }
 
-void free(void* ptr) {
-    if (!ptr || !heap_start) return;
+/* Return a block to the first-fit heap */
+static void heap_release(mem_block_t *blk) {
+    blk->free = BLK_FREE;
+    blk->cls = -1;
+    heap_used -= blk->size;
+    coalesce(blk);
+}
+
+/* Get at least req more bytes of free heap from the page-frame allocator */
+static int heap_grow(size_t req) {
+    uint32_t bytes = req + PROLOGUE_SIZE + sizeof(mem_block_t);
+    uint32_t pages = (bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (pages < HEAP_GROW_PAGES) pages = HEAP_GROW_PAGES;
+
+    /* Extend the last region in place when the frames after it are free:
+       its epilogue becomes the header of the new free block */
+    mem_region_t *top = &regions[region_count - 1];
+    if (top->end % PAGE_SIZE == 0 && pmm_alloc_at(top->end, pages) == 0) {
+        mem_block_t *blk = (mem_block_t*)(top->end - sizeof(mem_block_t));
+        top->end += pages * PAGE_SIZE;
+        heap_size += pages * PAGE_SIZE;
+        set_epilogue(top->end);
+        blk->size = pages * PAGE_SIZE;
+        blk->free = BLK_FREE;
+        blk->cls = -1;
+        coalesce(blk);
+        return 0;
+    }
+
+    if (region_count == MEM_MAX_REGIONS) return -1;
+    uint32_t base = pmm_alloc_contig(pages, 1);
+    if (!base) return -1;
+    region_add(base, base + pages * PAGE_SIZE);
+    return 0;
+}
+
+/* Give every cached block back to the first-fit heap so it can coalesce.
+   Used when the heap runs dry; returns the number of blocks released. */
+static uint32_t flush_classes(void) {
+    uint32_t released = 0;
+    int c;
+    for (c = 0; c < MEM_NUM_CLASSES; c++) {
+        while (classes[c].head) {
+            class_node_t *node = classes[c].head;
+            classes[c].head = node->next;
+            classes[c].cached--;
+            heap_release((mem_block_t*)node - 1);
+            released++;
+        }
+    }
+    return released;
+}
+
+static void* heap_malloc(size_t size) {
+    /* Small requests: pop a cached block of the same class in O(1) */
+    int cls = size_class(size);
+    if (cls >= 0) {
+        size_class_t *sc = &classes[cls];
+        if (sc->head) {
+            class_node_t *node = sc->head;
+            sc->head = node->next;
+            sc->cached--;
+            sc->in_use++;
+            sc->hits++;
+            ((mem_block_t*)node - 1)->free = BLK_USED;
+            return node;
+        }
+        sc->misses++;
+        /* Carve the full class size so the block can serve any request
+           of this class once it is cached */
+        size = class_size(cls);
+    }
+
+    /* Required size: header + payload + footer, aligned */
+    size_t req = align_up(BLOCK_OVERHEAD + size);
+    if (req < MIN_BLOCK) req = MIN_BLOCK;
+
+    mem_block_t *blk = heap_alloc(req);
+    if (!blk && heap_grow(req) == 0) {
+        blk = heap_alloc(req);
+    }
+    if (!blk && flush_classes()) {
+        blk = heap_alloc(req);
+    }
+    if (!blk) return NULL; /* Out of memory */
+
+    blk->cls = cls;
+    if (cls >= 0) classes[cls].in_use++;
+    return (void*)((uint8_t*)blk + sizeof(mem_block_t));
+}
 
+static void heap_free(void* ptr) {
     /* Get block header (located before payload) */
     mem_block_t *blk = (mem_block_t*)ptr - 1;
 
-    if (blk->free) {
-        serial_puts("[MEM] Double-free detected at ");
-        print_hex((uint32_t)ptr);
-        serial_puts("\n");
+    if (blk->free != BLK_USED) {
+        klog("[MEM] Double-free detected at %p\n", ptr);
         return;
     }
 
-    blk->free = 1;
-    heap_used -= blk->size;
+    /* Small blocks are parked on their class list for O(1) reuse */
+    if (blk->cls >= 0) {
+        size_class_t *sc = &classes[blk->cls];
+        class_node_t *node = (class_node_t*)ptr;
+        blk->free = BLK_CACHED;
+        node->next = sc->head;
+        sc->head = node;
+        sc->in_use--;
+        sc->cached++;
+        return;
+    }
 
-    /* Attempt coalescing */
-    coalesce(blk);
+    heap_release(blk);
+}
+
+/* Cut a used first-fit block down to req bytes, returning the tail to the
+   heap (where it coalesces with a free successor) if it is big enough */
+static void split_tail(mem_block_t *blk, size_t req) {
+    if (blk->size < req + MIN_BLOCK) return;
+
+    mem_block_t *rest = (mem_block_t*)((uint8_t*)blk + req);
+    rest->size = blk->size - req;
+    blk->size = req;
+    set_footer(blk);
+    heap_release(rest);
+}
+
+static void* heap_realloc(void* ptr, size_t new_size) {
+    mem_block_t *blk = (mem_block_t*)ptr - 1;
+    size_t old_size = blk->size - BLOCK_OVERHEAD;
+
+    if (blk->cls >= 0) {
+        /* Class blocks stay whole so they can be recycled by class; keep
+           the block while the request still maps to the same class */
+        if (size_class(new_size) == blk->cls) return ptr;
+    } else {
+        size_t req = align_up(BLOCK_OVERHEAD + new_size);
+        if (req < MIN_BLOCK) req = MIN_BLOCK;
+
+        /* Shrink: give the unused tail back */
+        if (req <= blk->size) {
+            split_tail(blk, req);
+            return ptr;
+        }
+
+        /* Grow: absorb a free physical successor if it is large enough */
+        mem_block_t *next = next_block(blk);
+        if (next->free == BLK_FREE && blk->size + next->size >= req) {
+            fl_remove(next);
+            heap_used += next->size;
+            blk->size += next->size;
+            set_footer(blk);
+            split_tail(blk, req);
+            return ptr;
+        }
+    }
+
+    /* Allocate new block, copy data, free old */
+    void *new_ptr = heap_malloc(new_size);
+    if (!new_ptr) return NULL;
+
+    memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    heap_free(ptr);
+    return new_ptr;
+}
+
+/* Public entry points: tasks are preemptible, so the heap is only touched
+   with interrupts disabled */
+
+void* malloc(size_t size) {
+    if (size == 0) return NULL;
+    if (!heap_start) return NULL;
+
+    uint32_t flags = irq_save();
+    PROF_START(t0);
+    void *ptr = heap_malloc(size);
+    PROF_END(PROF_MALLOC, t0);
+    irq_restore(flags);
+    return ptr;
+}
+
+void free(void* ptr) {
+    if (!ptr || !heap_start) return;
+
+    uint32_t flags = irq_save();
+    PROF_START(t0);
+    heap_free(ptr);
+    PROF_END(PROF_FREE, t0);
+    irq_restore(flags);
 }
 
 void* realloc(void* ptr, size_t new_size) {
@@ -155,78 +431,171 @@ void* realloc(void* ptr, size_t new_size) {
         return NULL;
     }
 
-    /* Get current block */
-    mem_block_t *blk = (mem_block_t*)ptr - 1;
-    size_t old_size = blk->size - sizeof(mem_block_t);
+    uint32_t flags = irq_save();
+    void *new_ptr = heap_realloc(ptr, new_size);
+    irq_restore(flags);
+    return new_ptr;
+}
 
-    /* If new size fits in current block, resize in-place */
-    if (new_size <= old_size) {
-        return ptr;
-    }
+size_t mem_block_size(void *ptr) {
+    return ptr ? ((mem_block_t*)ptr - 1)->size : 0;
+}
 
-    /* Allocate new block, copy data, free old */
-    void *new_ptr = malloc(new_size);
-    if (!new_ptr) return NULL;
+void mem_info(mem_info_t *out) {
+    int r;
+    out->heap_size = heap_size;
+    out->used = heap_used;
+    out->free = 0;
+    out->free_blocks = 0;
+    out->largest_free = 0;
+    out->alloc_blocks = 0;
+    out->cached = 0;
+    out->regions = region_count;
 
-    size_t i;
-    uint8_t *src = (uint8_t*)ptr;
-    uint8_t *dst = (uint8_t*)new_ptr;
-    for (i = 0; i < old_size; i++) {
-        dst[i] = src[i];
+    uint32_t flags = irq_save();
+    for (r = 0; r < region_count; r++) {
+        mem_block_t *blk = regions[r].first;
+        while (blk->size) {
+            if (blk->free == BLK_FREE) {
+                out->free += blk->size;
+                out->free_blocks++;
+                if (blk->size > out->largest_free) out->largest_free = blk->size;
+            } else if (blk->free == BLK_CACHED) {
+                out->cached += blk->size;
+            } else {
+                out->alloc_blocks++;
+            }
+            blk = next_block(blk);
+        }
     }
+    irq_restore(flags);
+}
 
-    free(ptr);
-    return new_ptr;
+static int check_fail(const char *what, void *where) {
+    klog("[MEM] Heap check failed: %s at %p\n", what, where);
+    return -1;
 }
 
-void mem_stats(void) {
-    uint32_t free_total = 0;
-    uint32_t free_count = 0;
-    uint32_t alloc_count = 0;
+/* Walk every region, the free list and the class caches and verify they
+   agree with each other. Meant for debugging and the host fuzzer; costs a
+   full heap walk. */
+static int heap_check(void) {
+    uint32_t used = 0, free_blocks = 0, cached = 0, listed = 0;
+    int r, c;
+
+    for (r = 0; r < region_count; r++) {
+        mem_region_t *rg = &regions[r];
+        mem_block_t *prologue = (mem_block_t*)rg->start;
+        if (prologue->size != PROLOGUE_SIZE || prologue->free != BLK_USED)
+            return check_fail("bad prologue", prologue);
+
+        mem_block_t *blk = rg->first;
+        int prev_free = 0;
+        while (blk->size) {
+            uint32_t at = (uint32_t)blk;
+            if (blk->size % HEAP_ALIGN || blk->size < MIN_BLOCK ||
+                at + blk->size > rg->end - sizeof(mem_block_t))
+                return check_fail("bad block size", blk);
+            if (*(uint32_t*)((uint8_t*)blk + blk->size - FOOTER_SIZE) != blk->size)
+                return check_fail("footer mismatch", blk);
+
+            if (blk->free == BLK_FREE) {
+                if (prev_free) return check_fail("uncoalesced free blocks", blk);
+                if (blk->cls != -1) return check_fail("free block has a class", blk);
+                free_blocks++;
+            } else if (blk->free == BLK_CACHED) {
+                if (blk->cls < 0 || blk->cls >= MEM_NUM_CLASSES)
+                    return check_fail("cached block without a class", blk);
+                used += blk->size;
+                cached++;
+            } else if (blk->free == BLK_USED) {
+                if (blk->cls >= MEM_NUM_CLASSES)
+                    return check_fail("bad class index", blk);
+                if (blk->cls >= 0 &&
+                    blk->size < BLOCK_OVERHEAD + class_size(blk->cls))
+                    return check_fail("class block too small", blk);
+                used += blk->size;
+            } else {
+                return check_fail("bad block state", blk);
+            }
+            prev_free = blk->free == BLK_FREE;
+            blk = next_block(blk);
+        }
+        if ((uint32_t)blk != rg->end - sizeof(mem_block_t))
+            return check_fail("epilogue misplaced", blk);
+    }
+    if (used != heap_used) return check_fail("used bytes mismatch", NULL);
 
+    /* Every free block is on the free list exactly once; the walk is
+       bounded so a cycle shows up as a count mismatch */
+    mem_block_t *prev = NULL;
     mem_block_t *blk = free_list;
-    while (blk) {
-        if (blk->free) {
-            free_total += blk->size;
-            free_count++;
-        } else {
-            alloc_count++;
+    while (blk && listed <= free_blocks) {
+        if (blk->free != BLK_FREE) return check_fail("non-free block on free list", blk);
+        if (links(blk)->prev != prev) return check_fail("broken free-list link", blk);
+        prev = blk;
+        blk = links(blk)->next;
+        listed++;
+    }
+    if (listed != free_blocks) return check_fail("free-list count mismatch", blk);
+
+    for (c = 0; c < MEM_NUM_CLASSES; c++) {
+        class_node_t *node = classes[c].head;
+        uint32_t n = 0;
+        while (node && n <= cached) {
+            mem_block_t *b = (mem_block_t*)node - 1;
+            if (b->free != BLK_CACHED || b->cls != c)
+                return check_fail("stray block on class list", b);
+            node = node->next;
+            n++;
         }
-        blk = (mem_block_t*)blk->list.next;
+        if (n != classes[c].cached) return check_fail("class count mismatch", node);
+        cached -= n;
     }
+    if (cached) return check_fail("cached block missing from its class", NULL);
+
+    return 0;
+}
+
+int mem_check(void) {
+    if (!heap_start) return 0;
 
+    uint32_t flags = irq_save();
+    int ret = heap_check();
+    irq_restore(flags);
+    return ret;
+}
+
+void mem_stats(void) {
+    mem_info_t mi;
+    int c;
+
+    mem_info(&mi);
     serial_puts("[MEM STATS]\n");
-    serial_puts("  Total heap:   ");
-    print_u32(heap_size);
-    serial_puts(" bytes\n");
-    serial_puts("  Used:         ");
-    print_u32(heap_used);
-    serial_puts(" bytes\n");
-    serial_puts("  Free:         ");
-    print_u32(free_total);
-    serial_puts(" bytes\n");
-    serial_puts("  Free blocks:  ");
-    print_u32(free_count);
-    serial_puts("\n");
-    serial_puts("  Alloc blocks: ");
-    print_u32(alloc_count);
-    serial_puts("\n");
+    kprintf("  Total heap:   %u bytes in %u region(s)\n", mi.heap_size, mi.regions);
+    kprintf("  Used:         %u bytes\n", mi.used);
+    kprintf("  Free:         %u bytes\n", mi.free);
+    kprintf("  Free blocks:  %u (largest %u)\n", mi.free_blocks, mi.largest_free);
+    kprintf("  Alloc blocks: %u\n", mi.alloc_blocks);
+    kprintf("  Cached:       %u bytes\n", mi.cached);
+    serial_puts("  CLASS\tHITS\tMISSES\tINUSE\tCACHED\n");
+    for (c = 0; c < MEM_NUM_CLASSES; c++) {
+        kprintf("  %u\t%u\t%u\t%u\t%u\n", class_size(c), classes[c].hits,
+                classes[c].misses, classes[c].in_use, classes[c].cached);
+    }
 }
 
 void mem_dump(void) {
     serial_puts("[MEM DUMP]\n");
     int idx = 0;
-    mem_block_t *blk = free_list;
-    while (blk) {
-        serial_puts("  [");
-        print_u32(idx++);
-        serial_puts("] addr=");
-        print_hex((uint32_t)blk);
-        serial_puts(" size=");
-        print_u32(blk->size);
-        serial_puts(" state=");
-        serial_puts(blk->free ? "FREE" : "USED");
-        serial_puts("\n");
-        blk = (mem_block_t*)blk->list.next;
+    int r;
+    for (r = 0; r < region_count; r++) {
+        mem_block_t *blk = regions[r].first;
+        while (blk->size) {
+            kprintf("  [%d] addr=%p size=%u state=%s\n", idx++, blk, blk->size,
+                    blk->free == BLK_FREE ? "FREE" :
+                    blk->free == BLK_CACHED ? "CACHED" : "USED");
+            blk = next_block(blk);
+        }
     }
 }
@@ -4,6 +4,24 @@
 
 #include "types.h"
 
+#ifdef KACCHI_HOST
+/* Host build (make host): keep clear of the C library's allocator */
+#define malloc  kmalloc
+#define free    kfree
+#define realloc krealloc
+#endif
+
+/* Size-class caches: power-of-two payload sizes MEM_CLASS_MIN..MEM_CLASS_MAX
+   are recycled through per-class free lists in O(1); larger requests use
+   the first-fit heap. */
+#define MEM_CLASS_MIN 16
+#define MEM_CLASS_MAX 2048
+#define MEM_NUM_CLASSES 8
+
+/* Initial heap size in pages; the heap grows on demand from the
+   page-frame allocator */
+#define MEM_INITIAL_PAGES 16
+
 /* Initialize the memory manager with available heap */
 void mem_init(uint32_t heap_start, uint32_t heap_size);
 
@@ -16,7 +34,28 @@ void free(void* ptr);
 /* Realloc - resize an allocation */
 void* realloc(void* ptr, size_t size);
 
-/* Get heap statistics */
+/* Bytes a live allocation occupies in the heap (header and footer included) */
+size_t mem_block_size(void *ptr);
+
+/* Heap totals in bytes (block sizes include header and footer) */
+typedef struct {
+    uint32_t heap_size;
+    uint32_t used;
+    uint32_t free;
+    uint32_t free_blocks;
+    uint32_t largest_free;
+    uint32_t alloc_blocks;
+    uint32_t cached;        /* parked in size-class caches */
+    uint32_t regions;
+} mem_info_t;
+
+void mem_info(mem_info_t *out);
+
+/* Verify the heap's internal invariants; returns 0, or -1 after logging
+   the first inconsistency found */
+int mem_check(void);
+
+/* Print heap statistics */
 void mem_stats(void);
 
 /* Dump all allocations (debug) */
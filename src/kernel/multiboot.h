@@ -0,0 +1,39 @@
+/* multiboot.h - Multiboot (v1) boot information passed in EBX */
+#ifndef MULTIBOOT_H
+#define MULTIBOOT_H
+
+#include "types.h"
+
+#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002
+
+/* multiboot_info_t.flags */
+#define MULTIBOOT_INFO_MEMORY  0x001    /* mem_lower/mem_upper valid */
+#define MULTIBOOT_INFO_CMDLINE 0x004    /* cmdline valid */
+#define MULTIBOOT_INFO_MMAP    0x040    /* mmap_addr/mmap_length valid */
+
+#define MULTIBOOT_MEMORY_AVAILABLE 1
+
+typedef struct {
+    uint32_t flags;
+    uint32_t mem_lower;         /* KB below 1 MB */
+    uint32_t mem_upper;         /* KB above 1 MB */
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;
+    uint32_t mmap_addr;
+} __attribute__((packed)) multiboot_info_t;
+
+/* Memory map entry; size does not include the size field itself */
+typedef struct {
+    uint32_t size;
+    uint32_t addr_low;
+    uint32_t addr_high;
+    uint32_t len_low;
+    uint32_t len_high;
+    uint32_t type;
+} __attribute__((packed)) multiboot_mmap_entry_t;
+
+#endif
@@ -0,0 +1,230 @@
+/* paging.c - Identity-mapped paging and stack guard pages */
+#include "paging.h"
+#include "cpu.h"
+#include "idt.h"
+#include "io.h"
+#include "klog.h"
+#include "kprintf.h"
+#include "pmm.h"
+#include "scheduler.h"
+#include "serial.h"
+
+#define PTE_PRESENT (1u << 0)
+#define PTE_WRITE   (1u << 1)
+#define PTE_PS      (1u << 7)       /* directory entry maps a 4 MB page */
+#define PTE_GLOBAL  (1u << 8)       /* survives CR3 reloads */
+#define PTE_GUARD   (1u << 9)       /* OS-available bit: unmapped guard page */
+
+#define CR0_PG  (1u << 31)
+#define CR4_PSE (1u << 4)
+#define CR4_PGE (1u << 7)
+
+#define PT_ENTRIES 1024
+#define LARGE_PAGE (PT_ENTRIES * PAGE_SIZE)
+
+static uint32_t page_dir[PT_ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+static uint32_t regions = 0;        /* directory entries covering RAM */
+static uint32_t global_bit = 0;     /* PTE_GLOBAL when the CPU has PGE */
+static int have_pse = 0;
+static int mode = PAGING_OFF;
+static uint32_t tables = 0;         /* page tables taken from the PMM */
+static uint32_t guards = 0;         /* guard pages currently unmapped */
+
+static uint32_t *pde_table(uint32_t pde) {
+    return (uint32_t*)(pde & ~(PAGE_SIZE - 1));
+}
+
+static int is_table(uint32_t pde) {
+    return (pde & PTE_PRESENT) && !(pde & PTE_PS);
+}
+
+/* Flush every TLB entry, global ones included */
+static void tlb_flush_all(void) {
+    if (mode == PAGING_OFF) return;
+    if (global_bit) {
+        uint32_t cr4 = read_cr4();
+        write_cr4(cr4 & ~CR4_PGE);
+        write_cr4(cr4);
+    } else {
+        write_cr3(read_cr3());
+    }
+}
+
+/* Give region i a page table with the same identity mapping */
+static int split(uint32_t i) {
+    uint32_t base = i * LARGE_PAGE;
+    uint32_t *pt;
+    uint32_t j;
+
+    if (is_table(page_dir[i])) return 0;
+    pt = (uint32_t*)pmm_alloc();
+    if (!pt) return -1;
+    for (j = 0; j < PT_ENTRIES; j++) {
+        pt[j] = (base + j * PAGE_SIZE) | PTE_PRESENT | PTE_WRITE | global_bit;
+    }
+    page_dir[i] = (uint32_t)pt | PTE_PRESENT | PTE_WRITE;
+    tables++;
+    return 0;
+}
+
+/* Put region i back on a single 4 MB page unless it holds a guard page.
+   The caller flushes the TLB (the paging-structure caches may still
+   point at the freed table). */
+static void merge(uint32_t i) {
+    uint32_t *pt;
+    uint32_t j;
+
+    if (!have_pse || !is_table(page_dir[i])) return;
+    pt = pde_table(page_dir[i]);
+    for (j = 0; j < PT_ENTRIES; j++) {
+        if (!(pt[j] & PTE_PRESENT)) return;
+    }
+    page_dir[i] = (i * LARGE_PAGE) | PTE_PRESENT | PTE_WRITE | PTE_PS | global_bit;
+    pmm_free((uint32_t)pt);
+    tables--;
+}
+
+static void enable(void) {
+    uint32_t cr0 = read_cr0();
+    if (cr0 & CR0_PG) return;
+    write_cr3((uint32_t)page_dir);
+    if (have_pse) write_cr4(read_cr4() | CR4_PSE);
+    write_cr0(cr0 | CR0_PG);
+    if (global_bit) write_cr4(read_cr4() | CR4_PGE);
+}
+
+static void disable(void) {
+    if (global_bit) write_cr4(read_cr4() & ~CR4_PGE);
+    write_cr0(read_cr0() & ~CR0_PG);
+}
+
+/* Page fault, or a double fault from the #DF task. A fault inside a guard
+   page means some stack ran past its bottom; either way nothing can be
+   resumed. */
+static void fault(interrupt_frame_t *f) {
+    uint32_t addr = read_cr2();
+    uint32_t pde = page_dir[addr / LARGE_PAGE];
+
+    if (is_table(pde) && (pde_table(pde)[(addr / PAGE_SIZE) % PT_ENTRIES] & PTE_GUARD)) {
+        kprintf("\n[PAGE] Stack overflow in pid %d: guard page 0x%08x hit at eip=0x%08x\n",
+                sched_getpid(), addr & ~(PAGE_SIZE - 1), f->eip);
+    } else {
+        kprintf("\n[PAGE] %s at 0x%08x err=0x%08x eip=0x%08x\n",
+                f->vector == EXC_DOUBLE_FAULT ? "Double fault" : "Page fault",
+                addr, f->err_code, f->eip);
+    }
+    serial_puts("[PAGE] System halted\n");
+    while (1) {
+        __asm__ volatile ("cli; hlt");
+    }
+}
+
+void paging_init(void) {
+    uint32_t features = cpu_features();
+    uint32_t i;
+
+    have_pse = (features & CPUID_EDX_PSE) != 0;
+    global_bit = (features & CPUID_EDX_PGE) ? PTE_GLOBAL : 0;
+
+    regions = (pmm_max_addr() + LARGE_PAGE - 1) / LARGE_PAGE;
+    if (regions == 0 || regions > PT_ENTRIES) regions = PT_ENTRIES;
+    for (i = 0; i < regions; i++) {
+        if (have_pse) {
+            page_dir[i] = (i * LARGE_PAGE) | PTE_PRESENT | PTE_WRITE | PTE_PS | global_bit;
+        } else if (split(i) < 0) {
+            klog("[PAGE] Out of frames for page tables, paging stays off\n");
+            return;
+        }
+    }
+
+    idt_set_page_dir((uint32_t)page_dir);
+    exception_register(EXC_PAGE_FAULT, fault);
+    exception_register(EXC_DOUBLE_FAULT, fault);
+    paging_set_mode(have_pse ? PAGING_4M : PAGING_4K);
+    klog("[PAGE] %u MB identity mapped with %s pages%s\n", regions * 4,
+         have_pse ? "4 MB" : "4 KB", global_bit ? ", global" : "");
+}
+
+int paging_set_mode(int m) {
+    uint32_t i;
+    int err = 0;
+
+    if (!regions) return -1;
+    if (m == PAGING_4M && !have_pse) return -1;
+
+    uint32_t flags = irq_save();
+    if (m == PAGING_OFF) {
+        disable();
+    } else {
+        for (i = 0; i < regions; i++) {
+            if (m == PAGING_4K) {
+                if (split(i) < 0) err = -1;
+            } else {
+                merge(i);
+            }
+        }
+        enable();
+    }
+    mode = m;
+    tlb_flush_all();
+    irq_restore(flags);
+    return err;
+}
+
+int paging_mode(void) {
+    return mode;
+}
+
+int paging_guard(uint32_t addr) {
+    uint32_t i = addr / LARGE_PAGE;
+
+    if (i >= regions) return -1;
+    uint32_t flags = irq_save();
+    if (split(i) < 0) {
+        irq_restore(flags);
+        return -1;
+    }
+    pde_table(page_dir[i])[(addr / PAGE_SIZE) % PT_ENTRIES] =
+        (addr & ~(PAGE_SIZE - 1)) | PTE_GUARD;
+    guards++;
+    if (mode != PAGING_OFF) invlpg(addr);
+    irq_restore(flags);
+    return 0;
+}
+
+void paging_unguard(uint32_t addr) {
+    uint32_t i = addr / LARGE_PAGE;
+    uint32_t *pte;
+
+    if (i >= regions || !is_table(page_dir[i])) return;
+    uint32_t flags = irq_save();
+    pte = &pde_table(page_dir[i])[(addr / PAGE_SIZE) % PT_ENTRIES];
+    if (*pte & PTE_GUARD) {
+        *pte = (addr & ~(PAGE_SIZE - 1)) | PTE_PRESENT | PTE_WRITE | global_bit;
+        guards--;
+        /* Back to one 4 MB page once the region's last guard is gone */
+        if (mode == PAGING_4M) {
+            merge(i);
+        }
+        if (mode != PAGING_OFF) invlpg(addr);
+    }
+    irq_restore(flags);
+}
+
+void paging_stats(void) {
+    static const char *names[] = { "off", "4 KB pages", "4 MB pages" };
+    uint32_t large = 0;
+    uint32_t i;
+
+    for (i = 0; i < regions; i++) {
+        if (page_dir[i] & PTE_PS) large++;
+    }
+    serial_puts("[PAGING]\n");
+    kprintf("  Mode:         %s%s\n", names[mode],
+            mode != PAGING_OFF && global_bit ? ", global" : "");
+    kprintf("  Mapped:       %u MB identity\n", regions * 4);
+    kprintf("  Kernel 4 MB:  %s\n", is_table(page_dir[0]) ? "split (4 KB pages)" : "one page");
+    kprintf("  4 MB pages:   %u\n", large);
+    kprintf("  Page tables:  %u\n", tables);
+    kprintf("  Guard pages:  %u\n", guards);
+}
@@ -0,0 +1,40 @@
+/* paging.h - Identity-mapped paging and stack guard pages */
+#ifndef PAGING_H
+#define PAGING_H
+
+#include "types.h"
+
+/* All RAM is identity mapped, so physical and virtual addresses stay the
+   same in every mode. With PSE each 4 MB region is one global page
+   directory entry; a region is split into a 4 KB page table only when it
+   holds a guard page (or in PAGING_4K mode). Without PSE every region
+   gets a page table. */
+#define PAGING_OFF 0    /* CR0.PG clear; tables kept, nothing enforced */
+#define PAGING_4K  1    /* every region mapped through a page table */
+#define PAGING_4M  2    /* 4 MB pages wherever there is no guard page */
+
+/* Guarded memory (task stacks) is taken from at or above this address,
+   so the first 4 MB region, which holds the kernel image, the frame
+   bitmap and the initial heap, is never split and stays one global page.
+   For the same reason page 0 stays mapped: NULL is not trapped. */
+#define PAGING_GUARD_FLOOR 0x400000
+
+/* Build the identity map over the PMM's range and enable paging in the
+   best mode the CPU supports (call after pmm_init) */
+void paging_init(void);
+
+/* Switch mode at run time (for benchmarks); returns 0 or -1 if the mode
+   is unsupported or a page table could not be allocated */
+int paging_set_mode(int mode);
+int paging_mode(void);
+
+/* Unmap the page at addr (page aligned) so any access faults and is
+   reported as a stack overflow; returns 0 or -1 if no page table frame
+   was available. paging_unguard() maps it back. */
+int paging_guard(uint32_t addr);
+void paging_unguard(uint32_t addr);
+
+/* Print the mode and mapping counts */
+void paging_stats(void);
+
+#endif
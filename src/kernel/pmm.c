@@ -0,0 +1,192 @@
+/* pmm.c - Physical page-frame allocator (one bit per 4 KB frame) */
+#include "pmm.h"
+#include "klog.h"
+#include "kprintf.h"
+#include "serial.h"
+#include "string.h"
+
+/* Set by link.ld, page aligned */
+extern uint8_t __kernel_end[];
+
+static uint32_t *bitmap = NULL;     /* bit set = frame used or reserved */
+static uint32_t max_frame = 0;      /* frames tracked: [0, max_frame) */
+static uint32_t total_frames = 0;   /* usable frames */
+static uint32_t used_frames = 0;    /* usable frames handed out */
+static uint32_t search_hint = 0;    /* first word that may have a free bit */
+
+static int frame_used(uint32_t f) {
+    return bitmap[f / 32] & (1u << (f % 32));
+}
+
+static void frame_set(uint32_t f) {
+    bitmap[f / 32] |= (1u << (f % 32));
+}
+
+static void frame_clear(uint32_t f) {
+    bitmap[f / 32] &= ~(1u << (f % 32));
+}
+
+/* Mark the usable part of [base, base+len) free, clipped to frames that
+   lie entirely above first_frame */
+static void release_range(uint32_t base, uint32_t len, uint32_t first_frame) {
+    uint32_t start = (base + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t end = (base + len) / PAGE_SIZE;   /* exclusive */
+    uint32_t f;
+    if (start < first_frame) start = first_frame;
+    if (end > max_frame) end = max_frame;
+    for (f = start; f < end; f++) {
+        if (frame_used(f)) {
+            frame_clear(f);
+            total_frames++;
+        }
+    }
+}
+
+void pmm_init(multiboot_info_t *mbi) {
+    uint32_t top = 0;
+    uint32_t kend = (uint32_t)__kernel_end;
+
+    /* Find the highest usable address (below 4 GB) */
+    if (mbi && (mbi->flags & MULTIBOOT_INFO_MMAP)) {
+        uint32_t p = mbi->mmap_addr;
+        while (p < mbi->mmap_addr + mbi->mmap_length) {
+            multiboot_mmap_entry_t *e = (multiboot_mmap_entry_t*)p;
+            if (e->type == MULTIBOOT_MEMORY_AVAILABLE && !e->addr_high) {
+                uint32_t end = e->addr_low + e->len_low;
+                if (e->len_high || end < e->addr_low) end = 0xFFFFF000;
+                if (end > top) top = end;
+            }
+            p += e->size + sizeof(e->size);
+        }
+    } else if (mbi && (mbi->flags & MULTIBOOT_INFO_MEMORY)) {
+        top = 0x100000 + mbi->mem_upper * 1024;
+    } else {
+        /* No boot info: assume 4 MB, the minimum we can run in */
+        top = 0x400000;
+    }
+
+    /* The bitmap itself lives in the first frames after the kernel */
+    max_frame = top / PAGE_SIZE;
+    uint32_t bitmap_words = (max_frame + 31) / 32;
+    uint32_t bitmap_bytes = bitmap_words * sizeof(uint32_t);
+    bitmap = (uint32_t*)kend;
+    memset(bitmap, 0xFF, bitmap_bytes);
+    uint32_t first_frame = (kend + bitmap_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    total_frames = 0;
+    used_frames = 0;
+    if (mbi && (mbi->flags & MULTIBOOT_INFO_MMAP)) {
+        uint32_t p = mbi->mmap_addr;
+        while (p < mbi->mmap_addr + mbi->mmap_length) {
+            multiboot_mmap_entry_t *e = (multiboot_mmap_entry_t*)p;
+            if (e->type == MULTIBOOT_MEMORY_AVAILABLE && !e->addr_high) {
+                uint32_t len = e->len_low;
+                if (e->len_high || e->addr_low + len < e->addr_low) {
+                    len = 0xFFFFF000 - e->addr_low;
+                }
+                release_range(e->addr_low, len, first_frame);
+            }
+            p += e->size + sizeof(e->size);
+        }
+    } else {
+        release_range(0x100000, top - 0x100000, first_frame);
+    }
+    search_hint = first_frame / 32;
+
+    klog("[PMM] %u frames (%u KB) usable above %u KB\n", total_frames,
+         total_frames * (PAGE_SIZE / 1024), first_frame * (PAGE_SIZE / 1024));
+}
+
+uint32_t pmm_alloc(void) {
+    uint32_t w;
+    uint32_t words = (max_frame + 31) / 32;
+    for (w = search_hint; w < words; w++) {
+        if (bitmap[w] != 0xFFFFFFFF) {
+            uint32_t f = w * 32 + __builtin_ctz(~bitmap[w]);
+            if (f >= max_frame) break;
+            frame_set(f);
+            used_frames++;
+            search_hint = w;
+            return f * PAGE_SIZE;
+        }
+    }
+    return 0;
+}
+
+uint32_t pmm_alloc_contig(uint32_t count, uint32_t align) {
+    return pmm_alloc_contig_above(count, align, 0);
+}
+
+uint32_t pmm_alloc_contig_above(uint32_t count, uint32_t align, uint32_t floor) {
+    uint32_t f, run = 0, base = 0;
+    if (count == 0) return 0;
+    if (align == 0) align = 1;
+
+    f = search_hint * 32;
+    if (f < floor / PAGE_SIZE) f = floor / PAGE_SIZE;
+    for (; f < max_frame; f++) {
+        if (frame_used(f)) {
+            run = 0;
+            continue;
+        }
+        if (run == 0) {
+            if (f & (align - 1)) continue;
+            base = f;
+        }
+        if (++run == count) {
+            for (f = base; f < base + count; f++) frame_set(f);
+            used_frames += count;
+            return base * PAGE_SIZE;
+        }
+    }
+    return 0;
+}
+
+int pmm_alloc_at(uint32_t addr, uint32_t count) {
+    uint32_t base = addr / PAGE_SIZE;
+    uint32_t f;
+    if (addr % PAGE_SIZE || base + count > max_frame) return -1;
+    for (f = base; f < base + count; f++) {
+        if (frame_used(f)) return -1;
+    }
+    for (f = base; f < base + count; f++) frame_set(f);
+    used_frames += count;
+    return 0;
+}
+
+void pmm_free(uint32_t addr) {
+    pmm_free_contig(addr, 1);
+}
+
+void pmm_free_contig(uint32_t addr, uint32_t count) {
+    uint32_t base = addr / PAGE_SIZE;
+    uint32_t f;
+    for (f = base; f < base + count && f < max_frame; f++) {
+        if (!frame_used(f)) {
+            klog("[PMM] Double free of frame %u\n", f);
+            continue;
+        }
+        frame_clear(f);
+        used_frames--;
+    }
+    if (base / 32 < search_hint) search_hint = base / 32;
+}
+
+uint32_t pmm_max_addr(void) {
+    return max_frame * PAGE_SIZE;
+}
+
+uint32_t pmm_total_frames(void) {
+    return total_frames;
+}
+
+uint32_t pmm_free_frames(void) {
+    return total_frames - used_frames;
+}
+
+void pmm_stats(void) {
+    serial_puts("[PMM STATS]\n");
+    kprintf("  Frames:       %u (%u KB)\n", total_frames, total_frames * (PAGE_SIZE / 1024));
+    kprintf("  Used:         %u\n", used_frames);
+    kprintf("  Free:         %u\n", total_frames - used_frames);
+}
@@ -0,0 +1,42 @@
+/* pmm.h - Physical page-frame allocator */
+#ifndef PMM_H
+#define PMM_H
+
+#include "types.h"
+#include "multiboot.h"
+
+#define PAGE_SIZE 4096
+
+/* Build the frame bitmap from the multiboot memory map. Only usable RAM
+   above __kernel_end is handed out. mbi may be NULL (no boot info). */
+void pmm_init(multiboot_info_t *mbi);
+
+/* Allocate one frame; returns its physical address or 0 */
+uint32_t pmm_alloc(void);
+
+/* Allocate count contiguous frames whose first frame is aligned to
+   align frames (power of two); returns the base address or 0 */
+uint32_t pmm_alloc_contig(uint32_t count, uint32_t align);
+
+/* pmm_alloc_contig() restricted to frames at or above floor */
+uint32_t pmm_alloc_contig_above(uint32_t count, uint32_t align, uint32_t floor);
+
+/* Claim count specific frames starting at addr if all are free;
+   returns 0 on success, -1 otherwise */
+int pmm_alloc_at(uint32_t addr, uint32_t count);
+
+/* Release frames obtained from any of the allocators above */
+void pmm_free(uint32_t addr);
+void pmm_free_contig(uint32_t addr, uint32_t count);
+
+/* End of the physical memory the frame bitmap covers */
+uint32_t pmm_max_addr(void);
+
+/* Frame counts */
+uint32_t pmm_total_frames(void);
+uint32_t pmm_free_frames(void);
+
+/* Print frame usage */
+void pmm_stats(void);
+
+#endif
@@ -3,49 +3,21 @@
 #define PROCESS_H
 
 #include "types.h"
+#include "scheduler.h"
 
-#define MAX_PROCESSES 32
-#define MAX_CHILDREN 8
-#define MAX_SIGNALS 16
-
-/* Process states */
-typedef enum {
-    PROC_FREE = 0,
-    PROC_CREATED,
-    PROC_RUNNING,
-    PROC_BLOCKED,
-    PROC_ZOMBIE
-} proc_state_t;
-
-/* Process structure */
-typedef struct process {
-    int pid;
-    int ppid;               /* parent pid */
-    proc_state_t state;
-    int exit_code;
-    
-    /* Children tracking */
-    int children[MAX_CHILDREN];
-    int child_count;
-    
-    /* Signal handling */
-    void (*signal_handlers[MAX_SIGNALS])(int);
-    
-    /* Resource tracking */
-    uint32_t *esp;          /* stack pointer (for scheduler) */
-    uint8_t *stack;         /* process stack */
-    
-    /* Accounting */
-    uint32_t cpu_ticks;
-} process_t;
+/* A process is a scheduler task seen through its parent/child, exit-code
+   and signal fields: both share one control block (pcb_t) */
+typedef pcb_t process_t;
 
 /* Initialize process manager */
 void proc_init(void);
 
-/* Create a new process */
-int proc_create(int ppid);
+/* Create a new process running fn as a child of the caller; returns its
+   pid or -1 */
+int proc_create(task_fn_t fn, int priority);
 
-/* Wait for child process */
+/* Collect an exited child: returns 0 and its exit code, or -1 if pid is
+   still running, detached (its parent exited first) or does not exist */
 int proc_wait(int pid, int *exit_code);
 
 /* Register signal handler */
@@ -54,7 +26,7 @@ void proc_signal_register(int sig, void (*handler)(int));
 /* Send signal to process */
 int proc_signal_send(int pid, int sig);
 
-/* Exit current process */
+/* Exit current process (does not return) */
 void proc_exit(int code);
 
 /* Get current process pid */
@@ -0,0 +1,150 @@
+/* prof.c - rdtsc-based probes with per-site cycle histograms */
+#include "prof.h"
+#include "cpu.h"
+#include "kprintf.h"
+#include "klog.h"
+#include "pit.h"
+#include "serial.h"
+#include "string.h"
+
+#define CAL_RUNS   3
+#define CAL_COUNT  11932        /* PIT clocks in 10 ms */
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t hist[PROF_BUCKETS];
+} prof_stats_t;
+
+static const char *probe_names[PROF_NUM_PROBES] = {
+    "context_switch", "pick_next", "malloc", "free"
+};
+
+static prof_stats_t stats[PROF_NUM_PROBES];
+static uint32_t tsc_khz = 0;
+
+/* 64-by-32 division with one divl (no libgcc); saturates on overflow */
+static uint32_t div64(uint64_t n, uint32_t d) {
+    uint32_t hi = (uint32_t)(n >> 32);
+    uint32_t q, r;
+    if (hi >= d) return 0xFFFFFFFF;
+    __asm__ ("divl %4" : "=a"(q), "=d"(r) : "a"((uint32_t)n), "d"(hi), "rm"(d));
+    return q;
+}
+
+static uint32_t bucket_of(uint32_t v) {
+    if (v < PROF_LINEAR) return v;
+    uint32_t msb = 31 - __builtin_clz(v);
+    return PROF_LINEAR + (msb - 4) * 4 + ((v >> (msb - 2)) & 3);
+}
+
+/* Largest value that falls into bucket b */
+static uint32_t bucket_top(uint32_t b) {
+    if (b < PROF_LINEAR) return b;
+    uint32_t msb = (b - PROF_LINEAR) / 4 + 4;
+    uint32_t sub = (b - PROF_LINEAR) % 4;
+    uint64_t lo = ((uint64_t)(4 + sub)) << (msb - 2);
+    return (uint32_t)(lo + (1ull << (msb - 2)) - 1);
+}
+
+void prof_init(void) {
+    uint32_t best = 0xFFFFFFFF;
+    int i;
+
+    if (!(cpu_features() & CPUID_EDX_TSC)) {
+        klog("[PROF] No TSC, cycle counts unavailable\n");
+        return;
+    }
+    for (i = 0; i < CAL_RUNS; i++) {
+        uint64_t t0 = rdtsc();
+        pit_wait(CAL_COUNT);
+        uint32_t d = (uint32_t)(rdtsc() - t0);
+        if (d < best) best = d;
+    }
+    /* cycles per 10 ms -> kHz */
+    tsc_khz = best / 10;
+    prof_reset();
+    klog("[PROF] TSC %u.%03u MHz, probes %s\n", tsc_khz / 1000, tsc_khz % 1000,
+         PROFILE ? "enabled" : "compiled out");
+}
+
+uint32_t prof_tsc_khz(void) {
+    return tsc_khz;
+}
+
+void prof_record(prof_probe_t probe, uint32_t cycles) {
+    uint32_t flags = irq_save();
+    prof_stats_t *s = &stats[probe];
+    s->count++;
+    s->sum += cycles;
+    if (cycles < s->min) s->min = cycles;
+    if (cycles > s->max) s->max = cycles;
+    s->hist[bucket_of(cycles)]++;
+    irq_restore(flags);
+}
+
+/* Upper edge of the bucket holding the 99th-percentile sample */
+static uint32_t p99(const prof_stats_t *s) {
+    uint32_t want = s->count - s->count / 100;
+    uint32_t seen = 0;
+    uint32_t b;
+    for (b = 0; b < PROF_BUCKETS; b++) {
+        seen += s->hist[b];
+        if (seen >= want) {
+            uint32_t top = bucket_top(b);
+            return top < s->max ? top : s->max;
+        }
+    }
+    return s->max;
+}
+
+/* Cycles to nanoseconds at the calibrated rate */
+static uint32_t to_ns(uint32_t cycles) {
+    if (!tsc_khz) return 0;
+    return div64((uint64_t)cycles * 1000000, tsc_khz);
+}
+
+uint32_t prof_cycles_to_ms(uint64_t cycles) {
+    if (!tsc_khz) return 0;
+    return div64(cycles, tsc_khz);
+}
+
+void prof_report(void) {
+    prof_stats_t snap;
+    int p;
+
+    if (!PROFILE) {
+        serial_puts("Profiling compiled out (built with PROFILE=0)\n");
+        return;
+    }
+    kprintf("[PERF] cycles (ns) at %u kHz TSC\n", tsc_khz);
+    serial_puts("  PROBE\t\tCOUNT\tMIN\tAVG\tP99\tMAX\n");
+    for (p = 0; p < PROF_NUM_PROBES; p++) {
+        uint32_t flags = irq_save();
+        snap = stats[p];
+        irq_restore(flags);
+
+        if (snap.count == 0) {
+            kprintf("  %-14s\t0\t-\t-\t-\t-\n", probe_names[p]);
+            continue;
+        }
+        uint32_t avg = div64(snap.sum, snap.count);
+        uint32_t q = p99(&snap);
+        kprintf("  %-14s\t%u\t%u\t%u\t%u\t%u\n", probe_names[p], snap.count,
+                snap.min, avg, q, snap.max);
+        kprintf("  %-14s\t\t(%u)\t(%u)\t(%u)\t(%u)\n", "", to_ns(snap.min),
+                to_ns(avg), to_ns(q), to_ns(snap.max));
+    }
+}
+
+void prof_reset(void) {
+    int p;
+    uint32_t flags = irq_save();
+    memset(stats, 0, sizeof(stats));
+    for (p = 0; p < PROF_NUM_PROBES; p++) {
+        stats[p].min = 0xFFFFFFFF;
+    }
+    irq_restore(flags);
+}
@@ -0,0 +1,50 @@
+/* prof.h - rdtsc-based probes with per-site cycle histograms */
+#ifndef PROF_H
+#define PROF_H
+
+#include "types.h"
+#include "io.h"
+
+/* Build with PROFILE=0 (make PROFILE=0) to compile every probe away */
+#ifndef PROFILE
+#define PROFILE 1
+#endif
+
+typedef enum {
+    PROF_CONTEXT_SWITCH = 0,    /* switch_to() -> incoming task resumed */
+    PROF_PICK_NEXT,             /* ready-queue selection */
+    PROF_MALLOC,
+    PROF_FREE,
+    PROF_NUM_PROBES
+} prof_probe_t;
+
+/* Histogram: exact buckets below 16 cycles, then four buckets per power
+   of two (about 25% resolution) up to 2^32 */
+#define PROF_LINEAR   16
+#define PROF_BUCKETS  (PROF_LINEAR + 28 * 4)
+
+#if PROFILE
+#define PROF_START(var)       uint64_t var = rdtsc()
+#define PROF_END(probe, var)  prof_record((probe), (uint32_t)(rdtsc() - (var)))
+#else
+#define PROF_START(var)       do { } while (0)
+#define PROF_END(probe, var)  do { } while (0)
+#endif
+
+/* Calibrate the TSC against PIT channel 2 (call before interrupts are on) */
+void prof_init(void);
+
+/* TSC frequency in kHz (0 if uncalibrated) */
+uint32_t prof_tsc_khz(void);
+
+/* Convert a cycle count to milliseconds (0 if uncalibrated) */
+uint32_t prof_cycles_to_ms(uint64_t cycles);
+
+/* Add one sample; callers normally use PROF_END() */
+void prof_record(prof_probe_t probe, uint32_t cycles);
+
+/* Print count/min/avg/p99/max for every probe */
+void prof_report(void);
+void prof_reset(void);
+
+#endif
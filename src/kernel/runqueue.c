@@ -0,0 +1,60 @@
+/* runqueue.c - Per-priority ready queues with an O(1) bitmap lookup */
+#include "runqueue.h"
+
+void rq_init(runqueue_t *rq) {
+    int i;
+    for (i = 0; i < NUM_PRIORITIES; i++) {
+        rq->head[i] = -1;
+        rq->tail[i] = -1;
+    }
+    for (i = 0; i < MAX_TASKS; i++) {
+        rq->node[i].prev = -1;
+        rq->node[i].next = -1;
+        rq->node[i].prio = 0;
+    }
+    rq->bitmap = 0;
+}
+
+void rq_enqueue(runqueue_t *rq, int idx, int prio) {
+    rq_node_t *n = &rq->node[idx];
+    n->prio = prio;
+    n->next = -1;
+    n->prev = rq->tail[prio];
+    if (rq->tail[prio] >= 0) {
+        rq->node[rq->tail[prio]].next = idx;
+    } else {
+        rq->head[prio] = idx;
+        rq->bitmap |= (1u << prio);
+    }
+    rq->tail[prio] = idx;
+}
+
+void rq_remove(runqueue_t *rq, int idx) {
+    rq_node_t *n = &rq->node[idx];
+    int prio = n->prio;
+    if (n->prev >= 0) {
+        rq->node[n->prev].next = n->next;
+    } else {
+        rq->head[prio] = n->next;
+    }
+    if (n->next >= 0) {
+        rq->node[n->next].prev = n->prev;
+    } else {
+        rq->tail[prio] = n->prev;
+    }
+    if (rq->head[prio] < 0) {
+        rq->bitmap &= ~(1u << prio);
+    }
+    n->prev = -1;
+    n->next = -1;
+}
+
+/* Highest non-empty level via the bitmap, then the head of that level's
+   FIFO (round-robin within a level) */
+int rq_pop(runqueue_t *rq) {
+    int prio = rq_top(rq);
+    if (prio < 0) return -1;
+    int idx = rq->head[prio];
+    rq_remove(rq, idx);
+    return idx;
+}
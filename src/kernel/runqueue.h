@@ -0,0 +1,40 @@
+/* runqueue.h - Per-priority ready queues with an O(1) bitmap lookup */
+#ifndef RUNQUEUE_H
+#define RUNQUEUE_H
+
+#include "types.h"
+#include "scheduler.h"
+
+/* Queue links for one task slot (pcb index, -1 = none) */
+typedef struct {
+    int prev;
+    int next;
+    int prio;               /* level the slot is queued on */
+} rq_node_t;
+
+/* One FIFO per priority level, plus a bitmap with bit N set whenever
+   head[N] is non-empty. Tasks are identified by their pcb index. */
+typedef struct {
+    int head[NUM_PRIORITIES];
+    int tail[NUM_PRIORITIES];
+    uint32_t bitmap;
+    rq_node_t node[MAX_TASKS];
+} runqueue_t;
+
+void rq_init(runqueue_t *rq);
+
+/* Append task idx to the tail of level prio */
+void rq_enqueue(runqueue_t *rq, int idx, int prio);
+
+/* Unlink a queued task */
+void rq_remove(runqueue_t *rq, int idx);
+
+/* Dequeue the head of the highest non-empty level, or -1 if empty */
+int rq_pop(runqueue_t *rq);
+
+/* Highest non-empty level, or -1 if every level is empty */
+static inline int rq_top(const runqueue_t *rq) {
+    return rq->bitmap ? 31 - __builtin_clz(rq->bitmap) : -1;
+}
+
+#endif
@@ -1,26 +1,208 @@
-/* scheduler.c - Cooperative round-robin scheduler */
+/* scheduler.c - Preemptive priority round-robin scheduler */
 #include "scheduler.h"
+#include "fpu.h"
+#include "idt.h"
+#include "io.h"
+#include "ipc.h"
+#include "kprintf.h"
+#include "paging.h"
+#include "pic.h"
+#include "pit.h"
+#include "pmm.h"
+#include "prof.h"
+#include "runqueue.h"
 #include "serial.h"
 #include "string.h"
 #include "types.h"
 
-/* Minimal PCB */
-typedef struct pcb {
-    uint32_t *esp;            /* saved stack pointer */
-    uint8_t stack[STACK_SIZE];
-    int pid;
-    task_state_t state;
-    int priority;
-    uint32_t wake_tick;
-} pcb_t;
-
 static pcb_t pcbs[MAX_TASKS];
+static uint64_t run_start;      /* rdtsc when the running task was switched in */
 static int current = 0; /* index of current running task */
-static int next_pid = 1;
-static uint32_t ticks = 0;
+/* Slots a new task may take (bit set): free slots and detached zombies.
+   Slot 0 is the null task's for good. */
+static uint32_t free_slots[MAX_TASKS / 32];
+static uint32_t slot_gen[MAX_TASKS];    /* generation of the slot's next pid */
+static volatile uint32_t ticks = 0;     /* advanced by the timer IRQ */
+static uint32_t timeslice = SCHED_TIMESLICE;
+static uint32_t slice_left = SCHED_TIMESLICE;
+
+/* Tickless idle state: while tickless is set the PIT runs as a one-shot
+   and IRQ0 only records that it fired; idle_wait() accounts the ticks. */
+static volatile int tickless = 0;
+static volatile int tickless_fired = 0;
+static volatile int oneshot_stale = 0;  /* expired one-shot IRQ still pending */
+static uint32_t idle_rem = 0;           /* PIT clocks idle short of a tick */
+
+/* PIT clocks before a periodic IRQ within which idle_wait() stays periodic
+   (reprogramming the counter takes a few port writes) */
+#define IDLE_PHASE_MARGIN 64
+
+/* Ready queues (runqueue.c). The running task is never queued. */
+static runqueue_t rq;
+
+/* Sleep queue: binary min-heap of pcb indices keyed on wake_tick, so each
+   tick only touches the sleepers that actually expire. */
+static int sleep_heap[MAX_TASKS];
+static int sleep_count = 0;
+static sched_timer_stats_t timer_stats;
+
+#if PROFILE
+static uint64_t switch_start;   /* rdtsc just before context_switch() */
+#endif
 
-/* extern assembly context switch */
+/* Boot stack (boot.S), inherited by the null task. It lies in the
+   kernel's 4 MB page, so it has no guard page, only the canary check. */
+extern uint8_t stack_bottom[], stack_top[];
+
+/* Bytes below the null task's frame left unfilled by sched_init(), which
+   memset() and anything else called from there may still use */
+#define NULL_STACK_MARGIN 1024
+
+/* extern assembly context switch and new-task trampoline (sched.S) */
 extern void context_switch(uint32_t **old_sp, uint32_t *new_sp);
+extern void task_entry(void);
+
+/* The task ran past the bottom of its stack and has overwritten whatever
+   lies below; nothing is trustworthy any more */
+static void stack_overflow(int idx) {
+    kprintf("\n[SCHED] Stack overflow in pid %d (%u-byte stack at %p)\n"
+            "[SCHED] System halted\n", pcbs[idx].pid, pcbs[idx].stack_size,
+            pcbs[idx].stack);
+    while (1) {
+        __asm__ volatile ("cli; hlt");
+    }
+}
+
+/* Stack frames: an unmapped guard page, then size bytes of stack (a page
+   multiple, all of it usable), taken above PAGING_GUARD_FLOOR when RAM
+   allows so the kernel's 4 MB page is left whole. Returns the stack
+   bottom or NULL. Without a page table frame for
+   the guard, the stack still works and only the canary check guards it. */
+static uint8_t *stack_alloc(uint32_t size) {
+    uint32_t base = pmm_alloc_contig_above(1 + size / PAGE_SIZE, 1, PAGING_GUARD_FLOOR);
+    if (!base) base = pmm_alloc_contig(1 + size / PAGE_SIZE, 1);
+    if (!base) return NULL;
+    paging_guard(base);
+    return (uint8_t*)(base + PAGE_SIZE);
+}
+
+static void stack_free(uint8_t *stack, uint32_t size) {
+    uint32_t base = (uint32_t)stack - PAGE_SIZE;
+    paging_unguard(base);
+    pmm_free_contig(base, 1 + size / PAGE_SIZE);
+}
+
+/* Slot of the live (or zombie) task with this pid, or -1 */
+static int find_slot(int pid) {
+    int i;
+    if (pid < 0) return -1;
+    i = PID_SLOT(pid);
+    if (pcbs[i].state != TASK_FREE && pcbs[i].pid == pid) return i;
+    return -1;
+}
+
+static void slot_release(int i) {
+    free_slots[i / 32] |= 1u << (i % 32);
+}
+
+/* A zombie nobody will reap: free its slot now (ps stops listing it and
+   its pid stops resolving). The stack stays with the slot for its next
+   task, which is why this is safe even for the exiting task itself. */
+static void retire(int i) {
+    pcbs[i].state = TASK_FREE;
+    slot_release(i);
+}
+
+/* Lowest reusable slot (keeps the live part of the table dense), or -1 */
+static int slot_take(void) {
+    int w;
+    for (w = 0; w < MAX_TASKS / 32; w++) {
+        if (free_slots[w]) {
+            int i = w * 32 + __builtin_ctz(free_slots[w]);
+            free_slots[w] &= ~(1u << (i % 32));
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Append task to the tail of its priority level */
+static void make_ready(int idx) {
+    rq_enqueue(&rq, idx, pcbs[idx].priority);
+}
+
+/* Wrap-safe "a expires before b" */
+static int tick_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+static void sleep_swap(int a, int b) {
+    int t = sleep_heap[a];
+    sleep_heap[a] = sleep_heap[b];
+    sleep_heap[b] = t;
+    pcbs[sleep_heap[a]].sleep_pos = a;
+    pcbs[sleep_heap[b]].sleep_pos = b;
+}
+
+static void sleep_sift_up(int pos) {
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!tick_before(pcbs[sleep_heap[pos]].wake_tick,
+                         pcbs[sleep_heap[parent]].wake_tick)) break;
+        sleep_swap(pos, parent);
+        pos = parent;
+    }
+}
+
+static void sleep_sift_down(int pos) {
+    while (1) {
+        int l = 2 * pos + 1;
+        int r = l + 1;
+        int min = pos;
+        if (l < sleep_count && tick_before(pcbs[sleep_heap[l]].wake_tick,
+                                           pcbs[sleep_heap[min]].wake_tick)) min = l;
+        if (r < sleep_count && tick_before(pcbs[sleep_heap[r]].wake_tick,
+                                           pcbs[sleep_heap[min]].wake_tick)) min = r;
+        if (min == pos) break;
+        sleep_swap(pos, min);
+        pos = min;
+    }
+}
+
+static void sleep_insert(int idx) {
+    int pos = sleep_count++;
+    sleep_heap[pos] = idx;
+    pcbs[idx].sleep_pos = pos;
+    sleep_sift_up(pos);
+}
+
+/* Remove the earliest sleeper from the heap and return its pcb index */
+static int sleep_pop(void) {
+    int idx = sleep_heap[0];
+    sleep_count--;
+    if (sleep_count > 0) {
+        sleep_heap[0] = sleep_heap[sleep_count];
+        pcbs[sleep_heap[0]].sleep_pos = 0;
+        sleep_sift_down(0);
+    }
+    pcbs[idx].sleep_pos = -1;
+    return idx;
+}
+
+/* Move every sleeper whose wake_tick has been reached onto its ready queue */
+static void wake_expired(void) {
+    uint64_t t0 = rdtsc();
+    while (sleep_count > 0 && !tick_before(ticks, pcbs[sleep_heap[0]].wake_tick)) {
+        int idx = sleep_pop();
+        pcbs[idx].state = TASK_READY;
+        make_ready(idx);
+        timer_stats.wakeups++;
+    }
+    uint32_t cycles = (uint32_t)(rdtsc() - t0);
+    timer_stats.ticks++;
+    timer_stats.cycles += cycles;
+    if (cycles > timer_stats.max_cycles) timer_stats.max_cycles = cycles;
+}
 
 static uint32_t* get_esp(void) {
     uint32_t* sp;
@@ -29,147 +211,488 @@ static uint32_t* get_esp(void) {
 }
 
 void sched_init(void) {
-    int i;
+    int i, j;
     for (i = 0; i < MAX_TASKS; i++) {
         pcbs[i].esp = NULL;
+        pcbs[i].stack = NULL;
+        pcbs[i].stack_size = 0;
+        pcbs[i].fpu_state = NULL;
         pcbs[i].pid = 0;
         pcbs[i].state = TASK_FREE;
         pcbs[i].priority = 0;
+        pcbs[i].base_priority = 0;
+        pcbs[i].locks_held = 0;
         pcbs[i].wake_tick = 0;
+        pcbs[i].sleep_pos = -1;
+        pcbs[i].wq_next = -1;
+        pcbs[i].ppid = -1;
+        pcbs[i].exit_code = 0;
+        pcbs[i].child_count = 0;
+        pcbs[i].cpu_cycles = 0;
+        for (j = 0; j < MAX_SIGNALS; j++) {
+            pcbs[i].signal_handlers[j] = NULL;
+        }
+        slot_gen[i] = 0;
     }
+    for (i = 0; i < MAX_TASKS / 32; i++) {
+        free_slots[i] = 0;
+    }
+    for (i = 1; i < MAX_TASKS; i++) {
+        slot_release(i);
+    }
+    rq_init(&rq);
+    sleep_count = 0;
+    sched_timer_stats_reset();
 
     /* Set up null process (pid 0) to capture current kernel stack */
     pcbs[0].pid = 0;
     pcbs[0].esp = get_esp();
     pcbs[0].state = TASK_RUNNING;
     pcbs[0].priority = 0;
+    pcbs[0].base_priority = 0;
     current = 0;
+    run_start = rdtsc();
+
+    /* The null task runs on the boot stack. Fill what lies safely below
+       the current frame with the canary so it is tracked like the rest. */
+    pcbs[0].stack = stack_bottom;
+    pcbs[0].stack_size = stack_top - stack_bottom;
+    uint8_t *sp = (uint8_t*)get_esp();
+    if (sp - stack_bottom > NULL_STACK_MARGIN) {
+        memset(stack_bottom, STACK_CANARY & 0xFF, sp - stack_bottom - NULL_STACK_MARGIN);
+    }
 }
 
 int create_task(task_fn_t fn, int priority) {
-    int i;
-    for (i = 1; i < MAX_TASKS; i++) {
-        if (pcbs[i].state == TASK_FREE) break;
+    return create_task_stack(fn, priority, STACK_SIZE);
+}
+
+int create_task_stack(task_fn_t fn, int priority, uint32_t stack_size) {
+    stack_size = (stack_size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (stack_size < STACK_MIN) stack_size = STACK_MIN;
+    if (stack_size > STACK_MAX) stack_size = STACK_MAX;
+
+    uint32_t flags = irq_save();
+    int i, j;
+    /* Retired slots may still hold the stack of their last task */
+    i = slot_take();
+    if (i < 0) {
+        irq_restore(flags);
+        return -1;
     }
-    if (i == MAX_TASKS) return -1;
+    if (pcbs[i].stack && pcbs[i].stack_size != stack_size) {
+        stack_free(pcbs[i].stack, pcbs[i].stack_size);
+        pcbs[i].stack = NULL;
+    }
+    if (!pcbs[i].stack) {
+        pcbs[i].stack = stack_alloc(stack_size);
+        if (!pcbs[i].stack) {
+            pcbs[i].state = TASK_FREE;
+            slot_release(i);
+            irq_restore(flags);
+            return -1;
+        }
+        pcbs[i].stack_size = stack_size;
+    }
+    memset(pcbs[i].stack, STACK_CANARY & 0xFF, stack_size);
 
-    pcbs[i].pid = next_pid++;
+    if (priority < 0) priority = 0;
+    if (priority > MAX_PRIORITY) priority = MAX_PRIORITY;
+
+    pcbs[i].pid = (int)(slot_gen[i] * MAX_TASKS + i);
+    slot_gen[i] = slot_gen[i] < PID_GEN_MAX ? slot_gen[i] + 1 : 0;
     pcbs[i].state = TASK_READY;
     pcbs[i].priority = priority;
+    pcbs[i].base_priority = priority;
+    pcbs[i].locks_held = 0;
     pcbs[i].wake_tick = 0;
+    pcbs[i].ppid = -1;
+    pcbs[i].exit_code = 0;
+    pcbs[i].child_count = 0;
+    pcbs[i].cpu_cycles = 0;
+    for (j = 0; j < MAX_SIGNALS; j++) {
+        pcbs[i].signal_handlers[j] = NULL;
+    }
 
-    /* Prepare initial stack for new task
-       Layout: [EDI][ESI][EBP][ESP][EBX][EDX][ECX][EAX][EIP]
-       We set registers to 0 and EIP to task entry. */
-    uint32_t *stk_top = (uint32_t*)(pcbs[i].stack + STACK_SIZE);
+    /* Prepare initial stack for new task, as context_switch() saves it
+       Layout: [EDI][ESI][EBX][EBP][EIP]
+       EIP is the task_entry trampoline, which calls fn (passed in EBX). */
+    uint32_t *stk_top = (uint32_t*)(pcbs[i].stack + stack_size);
     uint32_t *stk = stk_top;
 
-    *(--stk) = (uint32_t)fn; /* initial return address -> EIP */
-    *(--stk) = 0; /* EAX */
-    *(--stk) = 0; /* ECX */
-    *(--stk) = 0; /* EDX */
-    *(--stk) = 0; /* EBX */
-    *(--stk) = 0; /* ESP (ignored) */
+    *(--stk) = (uint32_t)task_entry; /* initial return address -> EIP */
     *(--stk) = 0; /* EBP */
+    *(--stk) = (uint32_t)fn; /* EBX */
     *(--stk) = 0; /* ESI */
     *(--stk) = 0; /* EDI */
 
     pcbs[i].esp = stk;
-    return pcbs[i].pid;
+    make_ready(i);
+    int pid = pcbs[i].pid;
+    irq_restore(flags);
+    return pid;
 }
 
-/* Choose next runnable task (simple priority + round-robin) */
+/* Choose next runnable task, or -1 if none is ready */
 static int pick_next(void) {
-    int best = -1;
-    int best_prio = -1000000;
-    int i;
-    for (i = 0; i < MAX_TASKS; i++) {
-        int idx = (current + 1 + i) % MAX_TASKS;
-        if (pcbs[idx].state == TASK_READY && pcbs[idx].wake_tick <= ticks) {
-            if (pcbs[idx].priority > best_prio) {
-                best_prio = pcbs[idx].priority;
-                best = idx;
-            }
-        }
+    if (!rq.bitmap) return -1;
+    PROF_START(t0);
+    int idx = rq_pop(&rq);
+    PROF_END(PROF_PICK_NEXT, t0);
+    return idx;
+}
+
+/* Switch from the current task to nxt. The outgoing task is re-queued only
+   if it is still runnable; blocked and zombie tasks stay off the queues.
+   Must be called with interrupts disabled. */
+static void switch_to(int nxt) {
+    int prev = current;
+    slice_left = timeslice;
+    if (nxt == prev) {
+        pcbs[current].state = TASK_RUNNING;
+        return;
+    }
+    if (*(uint32_t*)pcbs[prev].stack != STACK_CANARY) {
+        stack_overflow(prev);
     }
-    return best;
+    if (pcbs[prev].state == TASK_RUNNING) {
+        pcbs[prev].state = TASK_READY;
+        make_ready(prev);
+    }
+    current = nxt;
+    pcbs[current].state = TASK_RUNNING;
+
+    fpu_switch(&pcbs[current]);
+
+    /* Charge the outgoing task for its time on the CPU */
+    uint64_t now = rdtsc();
+    pcbs[prev].cpu_cycles += now - run_start;
+    run_start = now;
+
+#if PROFILE
+    /* Stamped by the outgoing task, recorded by the incoming one when its
+       own context_switch() returns (fresh tasks start in task_entry and
+       are not counted) */
+    switch_start = rdtsc();
+    context_switch(&pcbs[prev].esp, pcbs[current].esp);
+    prof_record(PROF_CONTEXT_SWITCH, (uint32_t)(rdtsc() - switch_start));
+#else
+    context_switch(&pcbs[prev].esp, pcbs[current].esp);
+#endif
 }
 
 void yield(void) {
-    /* advance ticks (simulated) */
-    ticks++;
-
+    uint32_t flags = irq_save();
     int nxt = pick_next();
-    if (nxt < 0) {
-        /* no ready task, continue current (null process) */
+    if (nxt >= 0) {
+        switch_to(nxt);
+    }
+    /* else: no ready task, continue current (null process) */
+    irq_restore(flags);
+}
+
+/* Halt until the next interrupt with nothing runnable. The periodic tick
+   is useless while idle, so the PIT is reprogrammed as a one-shot for the
+   earliest sleeper's deadline (capped to the whole ticks that fit the
+   16-bit counter, ~55 ms) and the ticks that passed are accounted on
+   wakeup. The part of the periodic tick already elapsed on entry, and
+   PIT clocks short of a whole tick on exit, carry over in idle_rem, so
+   repeated idle periods do not drift. Called with interrupts disabled. */
+static void idle_wait(void) {
+    uint32_t div = pit_divisor();
+    uint32_t count;
+    uint16_t left;
+
+    if (!SCHED_TICKLESS || !div || pic_pending(IRQ_TIMER)) {
+        /* a periodic tick already pending is accounted as a tick */
+        cpu_wait_irq();
+        return;
+    }
+    if (sleep_count > 0 && tick_before(pcbs[sleep_heap[0]].wake_tick, ticks + 2)) {
+        /* deadline is at most one tick away: keep the periodic tick */
+        cpu_wait_irq();
         return;
     }
 
-    int prev = current;
-    current = nxt;
-    pcbs[current].state = TASK_RUNNING;
-    pcbs[prev].state = (pcbs[prev].state == TASK_RUNNING) ? TASK_READY : pcbs[prev].state;
+    /* Credit what the current periodic tick has already run. Right before
+       its IRQ, take that tick instead: the reload could raise it while the
+       one-shot is being programmed. */
+    left = pit_read();
+    if (left < IDLE_PHASE_MARGIN || left > div) {
+        cpu_wait_irq();
+        return;
+    }
+    idle_rem += div - left;
+    if (idle_rem >= div) {
+        ticks++;
+        idle_rem -= div;
+    }
 
-    context_switch(&pcbs[prev].esp, pcbs[current].esp);
+    count = (0xFFFF / div) * div;
+    if (sleep_count > 0) {
+        uint32_t delta = pcbs[sleep_heap[0]].wake_tick - ticks;
+        if (delta < 0xFFFF / div) count = delta * div;
+    }
+    count -= idle_rem;          /* end on a tick boundary */
+
+    tickless = 1;
+    tickless_fired = 0;
+    pit_oneshot((uint16_t)count);
+    cpu_wait_irq();
+    tickless = 0;
+
+    uint32_t elapsed = count;
+    if (!tickless_fired) {
+        /* Woken early by another IRQ. Read the counter before the IRR: if
+           the one-shot expired meanwhile its IRQ is still pending, so the
+           full period counts and sched_tick() drops that IRQ. */
+        left = pit_read();
+        if (pic_pending(IRQ_TIMER)) {
+            oneshot_stale = 1;
+        } else if (left <= count) {
+            elapsed = count - left;
+        }
+    }
+    pit_init(SCHED_HZ);
+
+    elapsed += idle_rem;
+    ticks += elapsed / div;
+    idle_rem = elapsed % div;
+    wake_expired();
+}
+
+/* Pick the next task once the current one has given up the CPU. If nothing
+   is runnable, idle until an interrupt (normally the timer waking a
+   sleeper) makes a task ready. Called with interrupts disabled. */
+static int pick_next_blocking(void) {
+    int nxt;
+    while ((nxt = pick_next()) < 0) {
+        idle_wait();
+    }
+    return nxt;
 }
 
 void exit_task(void) {
+    int i;
+    irq_save();
     pcbs[current].state = TASK_ZOMBIE;
-    /* find next runnable */
-    int nxt = pick_next();
-    if (nxt < 0) {
-        /* switch back to null process */
-        nxt = 0;
+    fpu_release(&pcbs[current]);
+    ipc_task_exit(pcbs[current].pid);
+    if (pcbs[current].ppid < 0) retire(current);
+
+    /* Orphans are detached: nobody will wait for them any more */
+    for (i = 1; i < MAX_TASKS; i++) {
+        if (pcbs[i].state != TASK_FREE && pcbs[i].ppid == pcbs[current].pid) {
+            pcbs[i].ppid = -1;
+            if (pcbs[i].state == TASK_ZOMBIE) retire(i);
+        }
     }
-    int prev = current;
-    current = nxt;
-    pcbs[current].state = TASK_RUNNING;
-    context_switch(&pcbs[prev].esp, pcbs[current].esp);
+    switch_to(pick_next_blocking());
+    /* not reached: exited tasks are never switched back to */
 }
 
 void sleep_ticks(uint32_t t) {
+    uint32_t flags = irq_save();
     pcbs[current].wake_tick = ticks + t;
     pcbs[current].state = TASK_BLOCKED;
-    int nxt = pick_next();
-    if (nxt < 0) nxt = 0;
-    int prev = current;
-    current = nxt;
-    pcbs[current].state = TASK_RUNNING;
-    context_switch(&pcbs[prev].esp, pcbs[current].esp);
+    sleep_insert(current);
+    switch_to(pick_next_blocking());
+    irq_restore(flags);
+}
+
+/* IRQ-side preemption: switch away from the running task if a ready task
+   outranks it, or if its slice is used up and a task is ready at all.
+   Only a task that is actually running is preempted; the scheduler may be
+   halted in pick_next_blocking() on behalf of a blocked task. */
+static void preempt_check(int slice_expired) {
+    if (pcbs[current].state != TASK_RUNNING || !rq.bitmap) return;
+
+    int top = rq_top(&rq);
+    if (slice_expired || top > pcbs[current].priority) {
+        /* Requeue the running task behind its peers and take the best */
+        pcbs[current].state = TASK_READY;
+        make_ready(current);
+        switch_to(pick_next());
+    }
+}
+
+void sched_tick(void) {
+    if (tickless) {
+        /* one-shot deadline reached; idle_wait() does the accounting */
+        tickless_fired = 1;
+        return;
+    }
+    if (oneshot_stale) {
+        /* late IRQ of a one-shot idle_wait() already accounted */
+        oneshot_stale = 0;
+        return;
+    }
+    ticks++;
+    wake_expired();
+    if (slice_left > 0) slice_left--;
+    preempt_check(slice_left == 0);
+}
+
+void sched_wait(wait_queue_t *wq) {
+    pcbs[current].state = TASK_BLOCKED;
+    pcbs[current].wq_next = -1;
+    if (wq->tail >= 0) {
+        pcbs[wq->tail].wq_next = current;
+    } else {
+        wq->head = current;
+    }
+    wq->tail = current;
+    switch_to(pick_next_blocking());
+}
+
+void sched_wake_all(wait_queue_t *wq) {
+    uint32_t flags = irq_save();
+    int idx = wq->head;
+    wq->head = -1;
+    wq->tail = -1;
+    while (idx >= 0) {
+        int nxt = pcbs[idx].wq_next;
+        pcbs[idx].wq_next = -1;
+        pcbs[idx].state = TASK_READY;
+        make_ready(idx);
+        idx = nxt;
+    }
+    preempt_check(0);
+    irq_restore(flags);
+}
+
+int sched_wake_one(wait_queue_t *wq) {
+    uint32_t flags = irq_save();
+    int best = -1, best_prev = -1;
+    int prev = -1, idx;
+
+    /* Highest-priority waiter, the longest-waiting one among equals */
+    for (idx = wq->head; idx >= 0; prev = idx, idx = pcbs[idx].wq_next) {
+        if (best < 0 || pcbs[idx].priority > pcbs[best].priority) {
+            best = idx;
+            best_prev = prev;
+        }
+    }
+    if (best < 0) {
+        irq_restore(flags);
+        return -1;
+    }
+
+    if (best_prev >= 0) pcbs[best_prev].wq_next = pcbs[best].wq_next;
+    else wq->head = pcbs[best].wq_next;
+    if (wq->tail == best) wq->tail = best_prev;
+    pcbs[best].wq_next = -1;
+    pcbs[best].state = TASK_READY;
+    make_ready(best);
+    preempt_check(0);
+
+    int pid = pcbs[best].pid;
+    irq_restore(flags);
+    return pid;
+}
+
+int sched_priority(void) {
+    return pcbs[current].priority;
+}
+
+void sched_inherit(int pid, int prio) {
+    uint32_t flags = irq_save();
+    int i = find_slot(pid);
+    if (i >= 0 && pcbs[i].priority < prio) {
+        if (pcbs[i].state == TASK_READY) {
+            /* move it up to its new level */
+            rq_remove(&rq, i);
+            pcbs[i].priority = prio;
+            make_ready(i);
+        } else {
+            pcbs[i].priority = prio;
+        }
+    }
+    irq_restore(flags);
 }
 
-/* Print small integer */
-static void print_u32(uint32_t v) {
-    char buf[12];
-    int pos = 0;
-    if (v == 0) { serial_putc('0'); return; }
-    while (v) {
-        buf[pos++] = '0' + (v % 10);
-        v /= 10;
+void sched_lock_acquired(void) {
+    pcbs[current].locks_held++;
+}
+
+void sched_lock_released(void) {
+    uint32_t flags = irq_save();
+    if (--pcbs[current].locks_held == 0 &&
+        pcbs[current].priority != pcbs[current].base_priority) {
+        /* give up the inherited priority; a waiter that lent it runs now */
+        pcbs[current].priority = pcbs[current].base_priority;
+        preempt_check(0);
     }
-    while (pos--) serial_putc(buf[pos]);
+    irq_restore(flags);
+}
+
+void sched_set_timeslice(uint32_t t) {
+    if (t < 1) t = 1;
+    timeslice = t;
 }
 
 void sched_ps(void) {
-    serial_puts("PID\tSTATE\tPRIO\tWAKE\n");
+    serial_puts("PID\tSTATE\tPRIO\tWAKE\tSTACK\n");
     int i;
     for (i = 0; i < MAX_TASKS; i++) {
         if (pcbs[i].state != TASK_FREE) {
-            print_u32(pcbs[i].pid);
-            serial_puts("\t");
+            const char *state;
             switch (pcbs[i].state) {
-                case TASK_RUNNING: serial_puts("RUN   \t"); break;
-                case TASK_READY: serial_puts("READY \t"); break;
-                case TASK_BLOCKED: serial_puts("BLOCK \t"); break;
-                case TASK_ZOMBIE: serial_puts("ZOMBIE\t"); break;
-                default: serial_puts("FREE  \t"); break;
+                case TASK_RUNNING: state = "RUN"; break;
+                case TASK_READY: state = "READY"; break;
+                case TASK_BLOCKED: state = "BLOCK"; break;
+                case TASK_ZOMBIE: state = "ZOMBIE"; break;
+                default: state = "FREE"; break;
             }
-            print_u32(pcbs[i].priority);
-            serial_puts("\t");
-            print_u32(pcbs[i].wake_tick);
-            serial_puts("\n");
+            kprintf("%u\t%-6s\t%u\t%u\t%u/%u\n", pcbs[i].pid, state,
+                    pcbs[i].priority, pcbs[i].wake_tick,
+                    sched_stack_used(&pcbs[i]), pcbs[i].stack_size);
         }
     }
 }
 
 uint32_t sched_get_ticks(void) { return ticks; }
+
+int sched_getpid(void) { return pcbs[current].pid; }
+
+uint32_t sched_stack_used(pcb_t *t) {
+    const uint32_t *w = (const uint32_t*)t->stack;
+    uint32_t n = t->stack_size / 4, i = 0;
+    if (!w) return 0;
+    while (i < n && w[i] == STACK_CANARY) i++;
+    return (n - i) * 4;
+}
+
+pcb_t* sched_current(void) { return &pcbs[current]; }
+
+pcb_t* sched_find(int pid) {
+    int i = find_slot(pid);
+    return i >= 0 ? &pcbs[i] : NULL;
+}
+
+pcb_t* sched_slot(int i) { return &pcbs[i]; }
+
+void sched_reap(pcb_t *t) {
+    uint32_t flags = irq_save();
+    if (t->state == TASK_ZOMBIE) {
+        stack_free(t->stack, t->stack_size);
+        t->stack = NULL;
+        t->stack_size = 0;
+        t->state = TASK_FREE;
+        slot_release(t - pcbs);
+    }
+    irq_restore(flags);
+}
+
+void sched_timer_stats(sched_timer_stats_t *out) {
+    *out = timer_stats;
+    out->sleepers = sleep_count;
+}
+
+void sched_timer_stats_reset(void) {
+    timer_stats.ticks = 0;
+    timer_stats.wakeups = 0;
+    timer_stats.cycles = 0;
+    timer_stats.max_cycles = 0;
+    timer_stats.sleepers = 0;
+}
@@ -1,11 +1,47 @@
-/* scheduler.h - Simple cooperative scheduler API */
+/* scheduler.h - Preemptive priority scheduler API */
 #ifndef SCHEDULER_H
 #define SCHEDULER_H
 
 #include "types.h"
 
-#define MAX_TASKS 16
+#define MAX_TASKS 256       /* power of two: pids encode their slot */
+
+/* A pid is generation * MAX_TASKS + slot, so looking one up is a single
+   table index. Each reuse of a slot bumps its generation, so a stale pid
+   never names the slot's new task; a zombie keeps its pid until reaped. */
+#define PID_SLOT(pid) ((pid) & (MAX_TASKS - 1))
+#define PID_GEN_MAX (0x7FFFFFFF / MAX_TASKS)
+
+#if MAX_TASKS & (MAX_TASKS - 1)
+#error "MAX_TASKS must be a power of two"
+#endif
+
+/* Task stacks are whole page frames allocated per task, with an unmapped
+   guard page right below: STACK_SIZE by default, any page multiple in
+   STACK_MIN..STACK_MAX through create_task_stack(). They are filled with
+   STACK_CANARY so ps can show how deep each one has been used, and a task
+   whose bottom canary word is gone has overflowed (the check that is left
+   when paging is off). With the guard, a task costs stack_size + 4 KB of
+   frames: 8 KB at the default and minimum size. */
 #define STACK_SIZE 4096
+#define STACK_MIN 4096          /* one page; the guard page comes on top */
+#define STACK_MAX 65536
+#define STACK_CANARY 0x5A5A5A5A
+
+/* Process relationships and signals kept in every task (process.c) */
+#define MAX_CHILDREN 8
+#define MAX_SIGNALS 16
+
+/* Priority levels 0..MAX_PRIORITY, higher runs first */
+#define NUM_PRIORITIES 32
+#define MAX_PRIORITY (NUM_PRIORITIES - 1)
+
+/* Timer interrupt rate and default time slice (in ticks) */
+#define SCHED_HZ 100
+#define SCHED_TIMESLICE 5
+
+/* Stop the periodic tick while nothing is runnable (0 = always tick) */
+#define SCHED_TICKLESS 1
 
 typedef enum {
     TASK_FREE = 0,
@@ -17,14 +53,118 @@ typedef enum {
 
 typedef void (*task_fn_t)(void);
 
+/* Task control block: one per task, shared by the scheduler and the
+   process manager (process.c) */
+typedef struct pcb {
+    uint32_t *esp;            /* saved stack pointer */
+    uint8_t *stack;           /* lowest address of the stack */
+    uint32_t stack_size;
+    int pid;
+    task_state_t state;
+    int priority;             /* effective, possibly inherited */
+    int base_priority;        /* as created */
+    int locks_held;           /* mutexes owned (priority inheritance) */
+    uint32_t wake_tick;
+    int sleep_pos;            /* index in sleep_heap, -1 when not sleeping */
+    int wq_next;              /* next waiter on the same wait queue */
+    uint8_t *fpu_state;       /* FXSAVE area, allocated on first FPU use */
+
+    /* Process state */
+    int ppid;                 /* parent pid, -1 = detached */
+    int exit_code;
+    int children[MAX_CHILDREN];
+    int child_count;
+    void (*signal_handlers[MAX_SIGNALS])(int);
+
+    /* Accounting */
+    uint64_t cpu_cycles;      /* TSC cycles spent running */
+} pcb_t;
+
+/* FIFO of tasks blocked until some event (e.g. UART data) occurs */
+typedef struct {
+    int head;               /* pcb indices, -1 = empty */
+    int tail;
+} wait_queue_t;
+
+#define WAIT_QUEUE_INIT { -1, -1 }
+
 void sched_init(void);
+
+/* Start a detached task: nobody waits for it, so its slot is recycled as
+   soon as it exits. proc_create() makes a child of the caller instead. */
 int create_task(task_fn_t fn, int priority);
+
+/* create_task() with a stack of stack_size bytes (rounded up to whole
+   pages and clamped to STACK_MIN..STACK_MAX) */
+int create_task_stack(task_fn_t fn, int priority, uint32_t stack_size);
+
+/* Deepest stack use so far, in bytes (from the canary fill) */
+uint32_t sched_stack_used(pcb_t *t);
 void yield(void);
+
+/* End the running task. A task with a live parent stays a zombie until
+   the parent collects it with proc_wait(); its own children are detached. */
 void exit_task(void);
 void sleep_ticks(uint32_t ticks);
 void sched_ps(void);
 
+/* Timer interrupt handler: advances ticks, wakes sleepers, preempts */
+void sched_tick(void);
+
+/* Set the preemption time slice in ticks (minimum 1) */
+void sched_set_timeslice(uint32_t ticks);
+
+/* Block the current task on wq until sched_wake_all(wq). Must be called
+   with interrupts disabled; returns with them still disabled, so the
+   caller can re-check its condition without racing the waker. */
+void sched_wait(wait_queue_t *wq);
+
+/* Make every task on wq ready; one that outranks the running task
+   preempts it. Safe to call from IRQ handlers. */
+void sched_wake_all(wait_queue_t *wq);
+
+/* Make only the highest-priority waiter ready (the longest waiting among
+   equals), preempting the caller if it is outranked. Returns the woken
+   pid, or -1 if wq was empty. Safe to call from IRQ handlers. */
+int sched_wake_one(wait_queue_t *wq);
+
+/* Effective priority of the running task */
+int sched_priority(void);
+
+/* Priority inheritance for mutexes: a task blocking on a lock lends its
+   priority to the owner with sched_inherit(); lock owners report through
+   sched_lock_acquired()/sched_lock_released(), and the borrowed priority
+   is returned once the owner holds no more locks. */
+void sched_inherit(int pid, int prio);
+void sched_lock_acquired(void);
+void sched_lock_released(void);
+
+/* pid of the running task (0 for the null process) */
+int sched_getpid(void);
+
+/* Task control blocks: the running task, the task with a given pid (NULL
+   if none; constant time), and slot i of the table for walking it
+   (0 <= i < MAX_TASKS) */
+pcb_t* sched_current(void);
+pcb_t* sched_find(int pid);
+pcb_t* sched_slot(int i);
+
+/* Release a zombie's stack and slot once its exit code has been read */
+void sched_reap(pcb_t *t);
+
 /* Expose ticks for tests/inspections */
 uint32_t sched_get_ticks(void);
 
+/* Sleep-queue cost accounting (cycles spent waking sleepers per tick) */
+typedef struct {
+    uint32_t ticks;         /* ticks processed since reset */
+    uint32_t wakeups;       /* sleepers moved to READY */
+    uint32_t cycles;        /* total cycles spent in the wake path */
+    uint32_t max_cycles;    /* worst single tick */
+    uint32_t sleepers;      /* tasks currently in the sleep queue */
+} sched_timer_stats_t;
+
+void sched_timer_stats(sched_timer_stats_t *out);
+void sched_timer_stats_reset(void);
+
 #endif
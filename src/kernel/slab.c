@@ -0,0 +1,245 @@
+/* slab.c - Object-cache (slab) allocator for fixed-size kernel objects
+ *
+ * Each slab is a power-of-two run of page frames aligned to its own size,
+ * so the slab owning an object is found by masking the object address.
+ * The slab header sits at the start of the run, followed by a free-index
+ * array and the objects. Keeping the free list out of the objects leaves
+ * constructed state intact across free/alloc.
+ */
+#include "slab.h"
+#include "io.h"
+#include "klog.h"
+#include "kprintf.h"
+#include "pmm.h"
+#include "serial.h"
+#include "string.h"
+
+#define SLAB_MIN_OBJS  8        /* grow slabs until this many objects fit */
+#define SLAB_MAX_PAGES 16
+#define SLAB_END       0xFFFF   /* free-index list terminator */
+
+typedef struct slab {
+    kmem_cache_t *cache;
+    struct slab *prev;
+    struct slab *next;
+    uint8_t *objs;              /* first object */
+    uint16_t free_head;         /* index of first free object */
+    uint16_t in_use;
+    uint16_t free_next[];       /* per-object free-list links */
+} slab_t;
+
+struct kmem_cache {
+    char name[SLAB_NAME_LEN];
+    uint32_t obj_size;          /* size rounded up to the alignment */
+    uint32_t align;
+    uint32_t slab_pages;
+    uint32_t objs_per_slab;
+    void (*ctor)(void *obj);
+    slab_t *partial;            /* slabs with free and used objects */
+    slab_t *full;
+    slab_t *empty;              /* at most one kept for reuse */
+    uint32_t slabs;
+    uint32_t in_use;
+    uint32_t allocs;
+    uint32_t frees;
+    int active;
+};
+
+static kmem_cache_t caches[SLAB_MAX_CACHES];
+
+static uint32_t align_to(uint32_t v, uint32_t a) {
+    return (v + a - 1) & ~(a - 1);
+}
+
+/* Offset of the first object in a slab holding n objects */
+static uint32_t objs_offset(kmem_cache_t *c, uint32_t n) {
+    return align_to(sizeof(slab_t) + n * sizeof(uint16_t), c->align);
+}
+
+static void list_push(slab_t **head, slab_t *s) {
+    s->prev = NULL;
+    s->next = *head;
+    if (*head) (*head)->prev = s;
+    *head = s;
+}
+
+static void list_unlink(slab_t **head, slab_t *s) {
+    if (s->prev) s->prev->next = s->next;
+    else *head = s->next;
+    if (s->next) s->next->prev = s->prev;
+}
+
+kmem_cache_t* kmem_cache_create(const char *name, size_t size, size_t align,
+                                void (*ctor)(void *obj)) {
+    uint32_t flags = irq_save();
+    kmem_cache_t *c = NULL;
+    int i;
+
+    if (align < 8) align = 8;
+    if (size == 0 || (align & (align - 1))) goto out;
+
+    for (i = 0; i < SLAB_MAX_CACHES; i++) {
+        if (!caches[i].active) {
+            c = &caches[i];
+            break;
+        }
+    }
+    if (!c) goto out;
+
+    c->align = align;
+    c->obj_size = align_to(size, align);
+    c->ctor = ctor;
+
+    /* Smallest power-of-two slab that holds SLAB_MIN_OBJS objects */
+    c->slab_pages = 1;
+    while (1) {
+        uint32_t bytes = c->slab_pages * PAGE_SIZE;
+        uint32_t n = (bytes - sizeof(slab_t)) / (c->obj_size + sizeof(uint16_t));
+        while (n && objs_offset(c, n) + n * c->obj_size > bytes) n--;
+        c->objs_per_slab = n;
+        if (n >= SLAB_MIN_OBJS || c->slab_pages >= SLAB_MAX_PAGES) break;
+        c->slab_pages *= 2;
+    }
+    if (c->objs_per_slab == 0) {
+        c = NULL;
+        goto out;
+    }
+
+    strncpy(c->name, name ? name : "", SLAB_NAME_LEN - 1);
+    c->name[SLAB_NAME_LEN - 1] = '\0';
+    c->partial = NULL;
+    c->full = NULL;
+    c->empty = NULL;
+    c->slabs = 0;
+    c->in_use = 0;
+    c->allocs = 0;
+    c->frees = 0;
+    c->active = 1;
+
+out:
+    irq_restore(flags);
+    return c;
+}
+
+static slab_t* slab_new(kmem_cache_t *c) {
+    uint32_t base = pmm_alloc_contig(c->slab_pages, c->slab_pages);
+    uint32_t i;
+    if (!base) return NULL;
+
+    slab_t *s = (slab_t*)base;
+    s->cache = c;
+    s->objs = (uint8_t*)base + objs_offset(c, c->objs_per_slab);
+    s->in_use = 0;
+    s->free_head = 0;
+    for (i = 0; i < c->objs_per_slab; i++) {
+        s->free_next[i] = (i + 1 < c->objs_per_slab) ? i + 1 : SLAB_END;
+        if (c->ctor) c->ctor(s->objs + i * c->obj_size);
+    }
+    c->slabs++;
+    return s;
+}
+
+static void slab_release(kmem_cache_t *c, slab_t *s) {
+    pmm_free_contig((uint32_t)s, c->slab_pages);
+    c->slabs--;
+}
+
+void* kmem_cache_alloc(kmem_cache_t *c) {
+    uint32_t flags = irq_save();
+    slab_t *s = c->partial;
+
+    if (!s) {
+        s = c->empty;
+        if (s) {
+            c->empty = NULL;
+        } else {
+            s = slab_new(c);
+            if (!s) {
+                irq_restore(flags);
+                return NULL;
+            }
+        }
+        list_push(&c->partial, s);
+    }
+
+    uint16_t idx = s->free_head;
+    s->free_head = s->free_next[idx];
+    s->in_use++;
+    if (s->free_head == SLAB_END) {
+        list_unlink(&c->partial, s);
+        list_push(&c->full, s);
+    }
+    c->in_use++;
+    c->allocs++;
+
+    irq_restore(flags);
+    return s->objs + idx * c->obj_size;
+}
+
+void kmem_cache_free(kmem_cache_t *c, void *obj) {
+    if (!obj) return;
+
+    uint32_t flags = irq_save();
+    slab_t *s = (slab_t*)((uint32_t)obj & ~(c->slab_pages * PAGE_SIZE - 1));
+    uint32_t idx = ((uint8_t*)obj - s->objs) / c->obj_size;
+
+    if (s->cache != c || idx >= c->objs_per_slab) {
+        klog("[SLAB] Bad free to cache %s\n", c->name);
+        irq_restore(flags);
+        return;
+    }
+
+    if (s->free_head == SLAB_END) {
+        list_unlink(&c->full, s);
+        list_push(&c->partial, s);
+    }
+    s->free_next[idx] = s->free_head;
+    s->free_head = idx;
+    s->in_use--;
+    c->in_use--;
+    c->frees++;
+
+    if (s->in_use == 0) {
+        /* Keep one empty slab to absorb alloc/free churn */
+        list_unlink(&c->partial, s);
+        if (c->empty) {
+            slab_release(c, s);
+        } else {
+            c->empty = s;
+        }
+    }
+    irq_restore(flags);
+}
+
+int kmem_cache_destroy(kmem_cache_t *c) {
+    uint32_t flags = irq_save();
+    if (c->in_use) {
+        irq_restore(flags);
+        return -1;
+    }
+    /* All slabs are empty: partial and full lists are already empty */
+    if (c->empty) {
+        slab_release(c, c->empty);
+        c->empty = NULL;
+    }
+    c->active = 0;
+    irq_restore(flags);
+    return 0;
+}
+
+uint32_t kmem_cache_footprint(kmem_cache_t *c) {
+    return c->slabs * c->slab_pages * PAGE_SIZE;
+}
+
+void kmem_cache_stats(void) {
+    int i;
+    serial_puts("[SLAB STATS]\n");
+    serial_puts("  NAME\t\tSIZE\tSLABS\tOBJ/SLAB\tINUSE\tALLOCS\tFREES\n");
+    for (i = 0; i < SLAB_MAX_CACHES; i++) {
+        kmem_cache_t *c = &caches[i];
+        if (!c->active) continue;
+        kprintf("  %s%s%u\t%u\t%u\t\t%u\t%u\t%u\n", c->name,
+                strlen(c->name) < 6 ? "\t\t" : "\t", c->obj_size, c->slabs,
+                c->objs_per_slab, c->in_use, c->allocs, c->frees);
+    }
+}
@@ -0,0 +1,33 @@
+/* slab.h - Object-cache (slab) allocator for fixed-size kernel objects */
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "types.h"
+
+#define SLAB_MAX_CACHES 16
+#define SLAB_NAME_LEN   16
+
+typedef struct kmem_cache kmem_cache_t;
+
+/* Create a cache of size-byte objects aligned to align (power of two,
+   0 = 8). ctor, if given, runs once per object when its slab is created;
+   objects must be returned to the cache in their constructed state. */
+kmem_cache_t* kmem_cache_create(const char *name, size_t size, size_t align,
+                                void (*ctor)(void *obj));
+
+/* Allocate one object, or NULL when out of memory */
+void* kmem_cache_alloc(kmem_cache_t *cache);
+
+/* Return an object to the cache it came from */
+void kmem_cache_free(kmem_cache_t *cache, void *obj);
+
+/* Release every slab; fails (-1) while objects are still allocated */
+int kmem_cache_destroy(kmem_cache_t *cache);
+
+/* Bytes of page frames currently held by a cache */
+uint32_t kmem_cache_footprint(kmem_cache_t *cache);
+
+/* Print per-cache usage */
+void kmem_cache_stats(void);
+
+#endif
@@ -1,15 +1,63 @@
-/* string.c - String utility implementations */
+/* string.c - String and memory primitives
+ *
+ * Short operations run inline on word-at-a-time paths. Longer memcpy and
+ * memset calls go through a kernel picked by string_init(): rep movsd /
+ * rep stosd by default, SSE2 when CPUID reports it. Task switches keep
+ * each task's XMM registers (lazy FPU switching, fpu.c), but IRQ handlers
+ * run on the interrupted task's registers, so with interrupts disabled the
+ * rep kernels are used instead. The kernel is built without -msse, so the
+ * compiler never holds values in XMM registers and the asm blocks need
+ * not declare them.
+ */
 #include "string.h"
+#include "cpu.h"
+#include "io.h"
+#include "klog.h"
+
+#define STR_SMALL    64     /* below this, use the plain word loops */
+#define STR_SSE_MIN  256    /* SSE2 setup only pays off above this */
+
+/* Word access that may alias any object */
+typedef uint32_t __attribute__((may_alias)) word_t;
+
+#define ONES  0x01010101u
+#define HIGHS 0x80808080u
+#define HAS_ZERO(w) (((w) - ONES) & ~(w) & HIGHS)
+
+static void* (*memcpy_large)(void*, const void*, size_t) = memcpy_rep;
+static void* (*memset_large)(void*, int, size_t) = memset_rep;
 
 size_t strlen(const char* str) {
-    size_t len = 0;
-    while (str[len]) {
-        len++;
+    const char* p = str;
+
+    /* Reach a word boundary, then test four bytes per step. Aligned word
+       reads never cross a page, so reading past the NUL is safe. */
+    while ((uint32_t)p & 3) {
+        if (!*p) return p - str;
+        p++;
+    }
+    const word_t* w = (const word_t*)p;
+    while (!HAS_ZERO(*w)) {
+        w++;
+    }
+    p = (const char*)w;
+    while (*p) {
+        p++;
     }
-    return len;
+    return p - str;
 }
 
 int strcmp(const char* str1, const char* str2) {
+    if ((((uint32_t)str1 | (uint32_t)str2) & 3) == 0) {
+        const word_t* w1 = (const word_t*)str1;
+        const word_t* w2 = (const word_t*)str2;
+        while (*w1 == *w2 && !HAS_ZERO(*w1)) {
+            w1++;
+            w2++;
+        }
+        str1 = (const char*)w1;
+        str2 = (const char*)w2;
+    }
     while (*str1 && (*str1 == *str2)) {
         str1++;
         str2++;
@@ -17,8 +65,256 @@ int strcmp(const char* str1, const char* str2) {
     return *(unsigned char*)str1 - *(unsigned char*)str2;
 }
 
+int strncmp(const char* str1, const char* str2, size_t n) {
+    while (n && *str1 && (*str1 == *str2)) {
+        str1++;
+        str2++;
+        n--;
+    }
+    if (n == 0) return 0;
+    return *(unsigned char*)str1 - *(unsigned char*)str2;
+}
+
 char* strcpy(char* dest, const char* src) {
-    char* original_dest = dest;
-    while ((*dest++ = *src++));
-    return original_dest;
-}
\ No newline at end of file
+    memcpy(dest, src, strlen(src) + 1);
+    return dest;
+}
+
+char* strncpy(char* dest, const char* src, size_t n) {
+    size_t len = 0;
+    while (len < n && src[len]) {
+        len++;
+    }
+    memcpy(dest, src, len);
+    memset(dest + len, 0, n - len);
+    return dest;
+}
+
+/* ---- memcpy ---- */
+
+/* Copy a word at a time when both pointers are 4-byte aligned */
+void* memcpy_words(void* dest, const void* src, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+
+    if ((((uint32_t)d | (uint32_t)s) & 3) == 0) {
+        word_t* dw = (word_t*)d;
+        const word_t* sw = (const word_t*)s;
+        while (n >= 16) {
+            dw[0] = sw[0];
+            dw[1] = sw[1];
+            dw[2] = sw[2];
+            dw[3] = sw[3];
+            dw += 4;
+            sw += 4;
+            n -= 16;
+        }
+        while (n >= 4) {
+            *dw++ = *sw++;
+            n -= 4;
+        }
+        d = (uint8_t*)dw;
+        s = (const uint8_t*)sw;
+    }
+    while (n--) {
+        *d++ = *s++;
+    }
+    return dest;
+}
+
+/* rep movsd with the destination dword-aligned first */
+void* memcpy_rep(void* dest, const void* src, size_t n) {
+    void* d = dest;
+    size_t head = (0 - (uint32_t)dest) & 3;
+    if (head > n) head = n;
+    size_t words = (n - head) >> 2;
+    size_t tail = (n - head) & 3;
+
+    __asm__ volatile ("rep movsb" : "+D"(d), "+S"(src), "+c"(head) : : "memory");
+    __asm__ volatile ("rep movsl" : "+D"(d), "+S"(src), "+c"(words) : : "memory");
+    __asm__ volatile ("rep movsb" : "+D"(d), "+S"(src), "+c"(tail) : : "memory");
+    return dest;
+}
+
+/* 64 bytes per iteration: unaligned loads, aligned stores */
+void* memcpy_sse2(void* dest, const void* src, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+    size_t head = (0 - (uint32_t)d) & 15;
+    if (head > n) head = n;
+
+    memcpy_words(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    size_t blocks = n >> 6;
+    if (blocks) {
+        __asm__ volatile (
+            "1:\n\t"
+            "movdqu   (%1), %%xmm0\n\t"
+            "movdqu 16(%1), %%xmm1\n\t"
+            "movdqu 32(%1), %%xmm2\n\t"
+            "movdqu 48(%1), %%xmm3\n\t"
+            "movdqa %%xmm0,   (%0)\n\t"
+            "movdqa %%xmm1, 16(%0)\n\t"
+            "movdqa %%xmm2, 32(%0)\n\t"
+            "movdqa %%xmm3, 48(%0)\n\t"
+            "addl $64, %1\n\t"
+            "addl $64, %0\n\t"
+            "decl %2\n\t"
+            "jnz 1b"
+            : "+r"(d), "+r"(s), "+r"(blocks)
+            :
+            : "memory", "cc");
+    }
+    memcpy_words(d, s, n & 63);
+    return dest;
+}
+
+void* memcpy(void* dest, const void* src, size_t n) {
+    if (n < STR_SMALL) return memcpy_words(dest, src, n);
+    if (n < STR_SSE_MIN || !irq_enabled()) return memcpy_rep(dest, src, n);
+    return memcpy_large(dest, src, n);
+}
+
+void* memmove(void* dest, const void* src, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+
+    /* Every memcpy kernel copies forwards, which is safe unless the
+       destination starts inside the source */
+    if (d <= s || d >= s + n) {
+        return memcpy(dest, src, n);
+    }
+
+    d += n;
+    s += n;
+    while (n && ((uint32_t)d & 3)) {
+        *--d = *--s;
+        n--;
+    }
+    if (((uint32_t)s & 3) == 0) {
+        while (n >= 4) {
+            d -= 4;
+            s -= 4;
+            *(word_t*)d = *(const word_t*)s;
+            n -= 4;
+        }
+    }
+    while (n--) {
+        *--d = *--s;
+    }
+    return dest;
+}
+
+/* ---- memset ---- */
+
+void* memset_words(void* dest, int c, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    uint32_t pat = (uint8_t)c * ONES;
+
+    while (n && ((uint32_t)d & 3)) {
+        *d++ = (uint8_t)c;
+        n--;
+    }
+    word_t* dw = (word_t*)d;
+    while (n >= 16) {
+        dw[0] = pat;
+        dw[1] = pat;
+        dw[2] = pat;
+        dw[3] = pat;
+        dw += 4;
+        n -= 16;
+    }
+    while (n >= 4) {
+        *dw++ = pat;
+        n -= 4;
+    }
+    d = (uint8_t*)dw;
+    while (n--) {
+        *d++ = (uint8_t)c;
+    }
+    return dest;
+}
+
+void* memset_rep(void* dest, int c, size_t n) {
+    void* d = dest;
+    uint32_t pat = (uint8_t)c * ONES;
+    size_t head = (0 - (uint32_t)dest) & 3;
+    if (head > n) head = n;
+    size_t words = (n - head) >> 2;
+    size_t tail = (n - head) & 3;
+
+    __asm__ volatile ("rep stosb" : "+D"(d), "+c"(head) : "a"(pat) : "memory");
+    __asm__ volatile ("rep stosl" : "+D"(d), "+c"(words) : "a"(pat) : "memory");
+    __asm__ volatile ("rep stosb" : "+D"(d), "+c"(tail) : "a"(pat) : "memory");
+    return dest;
+}
+
+void* memset_sse2(void* dest, int c, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    uint32_t pat = (uint8_t)c * ONES;
+    size_t head = (0 - (uint32_t)d) & 15;
+    if (head > n) head = n;
+
+    memset_words(d, c, head);
+    d += head;
+    n -= head;
+
+    size_t blocks = n >> 6;
+    if (blocks) {
+        __asm__ volatile (
+            "movd %2, %%xmm0\n\t"
+            "pshufd $0, %%xmm0, %%xmm0\n\t"
+            "1:\n\t"
+            "movdqa %%xmm0,   (%0)\n\t"
+            "movdqa %%xmm0, 16(%0)\n\t"
+            "movdqa %%xmm0, 32(%0)\n\t"
+            "movdqa %%xmm0, 48(%0)\n\t"
+            "addl $64, %0\n\t"
+            "decl %1\n\t"
+            "jnz 1b"
+            : "+r"(d), "+r"(blocks)
+            : "r"(pat)
+            : "memory", "cc");
+    }
+    memset_words(d, c, n & 63);
+    return dest;
+}
+
+void* memset(void* dest, int c, size_t n) {
+    if (n < STR_SMALL) return memset_words(dest, c, n);
+    if (n < STR_SSE_MIN || !irq_enabled()) return memset_rep(dest, c, n);
+    return memset_large(dest, c, n);
+}
+
+int memcmp(const void* a, const void* b, size_t n) {
+    const uint8_t* p = (const uint8_t*)a;
+    const uint8_t* q = (const uint8_t*)b;
+
+    if ((((uint32_t)p | (uint32_t)q) & 3) == 0) {
+        while (n >= 4 && *(const word_t*)p == *(const word_t*)q) {
+            p += 4;
+            q += 4;
+            n -= 4;
+        }
+    }
+    while (n) {
+        if (*p != *q) return *p - *q;
+        p++;
+        q++;
+        n--;
+    }
+    return 0;
+}
+
+void string_init(void) {
+    if (cpu_sse2_enabled()) {
+        memcpy_large = memcpy_sse2;
+        memset_large = memset_sse2;
+        klog("[STR] memcpy/memset: SSE2 above 256 bytes, rep movsd/stosd below\n");
+    } else {
+        klog("[STR] memcpy/memset: rep movsd/stosd\n");
+    }
+}
@@ -1,4 +1,4 @@
-/* string.h - String utility functions */
+/* string.h - String and memory utility functions */
 #ifndef STRING_H
 #define STRING_H
 
@@ -6,6 +6,24 @@
 
 size_t strlen(const char* str);
 int strcmp(const char* str1, const char* str2);
+int strncmp(const char* str1, const char* str2, size_t n);
 char* strcpy(char* dest, const char* src);
+char* strncpy(char* dest, const char* src, size_t n);
 
-#endif
\ No newline at end of file
+void* memcpy(void* dest, const void* src, size_t n);
+void* memmove(void* dest, const void* src, size_t n);
+void* memset(void* dest, int c, size_t n);
+int memcmp(const void* a, const void* b, size_t n);
+
+/* Pick the memcpy/memset kernels for this CPU (call after cpu_init) */
+void string_init(void);
+
+/* Individual kernels behind memcpy()/memset(), exposed for benchmarks */
+void* memcpy_words(void* dest, const void* src, size_t n);
+void* memcpy_rep(void* dest, const void* src, size_t n);
+void* memcpy_sse2(void* dest, const void* src, size_t n);
+void* memset_words(void* dest, int c, size_t n);
+void* memset_rep(void* dest, int c, size_t n);
+void* memset_sse2(void* dest, int c, size_t n);
+
+#endif
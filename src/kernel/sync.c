@@ -0,0 +1,123 @@
+/* sync.c - Blocking semaphores, mutexes and condition variables */
+#include "sync.h"
+#include "io.h"
+
+static void wq_init(wait_queue_t *wq) {
+    wq->head = -1;
+    wq->tail = -1;
+}
+
+/* ---- Semaphores ---- */
+
+void sem_init(semaphore_t *s, int count) {
+    s->count = count;
+    wq_init(&s->wq);
+}
+
+void sem_wait(semaphore_t *s) {
+    uint32_t flags = irq_save();
+    while (s->count == 0) {
+        sched_wait(&s->wq);
+    }
+    s->count--;
+    irq_restore(flags);
+}
+
+int sem_trywait(semaphore_t *s) {
+    uint32_t flags = irq_save();
+    int ret = -1;
+    if (s->count > 0) {
+        s->count--;
+        ret = 0;
+    }
+    irq_restore(flags);
+    return ret;
+}
+
+void sem_post(semaphore_t *s) {
+    uint32_t flags = irq_save();
+    s->count++;
+    sched_wake_one(&s->wq);
+    irq_restore(flags);
+}
+
+/* ---- Mutexes ---- */
+
+void mutex_init(mutex_t *m) {
+    m->owner = -1;
+    wq_init(&m->wq);
+}
+
+void mutex_lock(mutex_t *m) {
+    uint32_t flags = irq_save();
+    while (m->owner >= 0) {
+        /* Lend our priority so a lower-priority owner cannot be starved
+           by tasks ranked between us while we wait */
+        sched_inherit(m->owner, sched_priority());
+        sched_wait(&m->wq);
+    }
+    m->owner = sched_getpid();
+    sched_lock_acquired();
+    irq_restore(flags);
+}
+
+int mutex_trylock(mutex_t *m) {
+    uint32_t flags = irq_save();
+    int ret = -1;
+    if (m->owner < 0) {
+        m->owner = sched_getpid();
+        sched_lock_acquired();
+        ret = 0;
+    }
+    irq_restore(flags);
+    return ret;
+}
+
+void mutex_unlock(mutex_t *m) {
+    uint32_t flags = irq_save();
+    if (m->owner != sched_getpid()) {
+        irq_restore(flags);
+        return;
+    }
+    m->owner = -1;
+    /* The woken waiter takes the lock when it runs; dropping an inherited
+       priority afterwards lets it preempt us right here */
+    sched_wake_one(&m->wq);
+    sched_lock_released();
+    irq_restore(flags);
+}
+
+/* ---- Condition variables ---- */
+
+void cond_init(condvar_t *cv) {
+    cv->seq = 0;
+    wq_init(&cv->wq);
+}
+
+void cond_wait(condvar_t *cv, mutex_t *m) {
+    uint32_t flags = irq_save();
+    uint32_t seq = cv->seq;
+
+    /* Releasing m can switch to a waiter that signals before we are on
+       the queue; the sequence number catches that */
+    mutex_unlock(m);
+    if (cv->seq == seq) {
+        sched_wait(&cv->wq);
+    }
+    irq_restore(flags);
+    mutex_lock(m);
+}
+
+void cond_signal(condvar_t *cv) {
+    uint32_t flags = irq_save();
+    cv->seq++;
+    sched_wake_one(&cv->wq);
+    irq_restore(flags);
+}
+
+void cond_broadcast(condvar_t *cv) {
+    uint32_t flags = irq_save();
+    cv->seq++;
+    sched_wake_all(&cv->wq);
+    irq_restore(flags);
+}
@@ -0,0 +1,50 @@
+/* sync.h - Blocking semaphores, mutexes and condition variables */
+#ifndef SYNC_H
+#define SYNC_H
+
+#include "types.h"
+#include "scheduler.h"
+
+/* Waiters sleep on scheduler wait queues instead of polling. A release
+   makes exactly one waiter ready (the highest-priority one), and that
+   waiter preempts the releasing task if it outranks it. */
+
+typedef struct {
+    int count;
+    wait_queue_t wq;
+} semaphore_t;
+
+/* Non-recursive lock with priority inheritance: while a task waits, the
+   owner runs at the waiter's priority if that is higher */
+typedef struct {
+    int owner;              /* pid, -1 = unlocked */
+    wait_queue_t wq;
+} mutex_t;
+
+typedef struct {
+    uint32_t seq;           /* bumped by every signal/broadcast */
+    wait_queue_t wq;
+} condvar_t;
+
+#define SEMAPHORE_INIT(n) { (n), WAIT_QUEUE_INIT }
+#define MUTEX_INIT        { -1, WAIT_QUEUE_INIT }
+#define CONDVAR_INIT      { 0, WAIT_QUEUE_INIT }
+
+void sem_init(semaphore_t *s, int count);
+void sem_wait(semaphore_t *s);
+int sem_trywait(semaphore_t *s);        /* 0 on success, -1 if it would block */
+void sem_post(semaphore_t *s);          /* safe from IRQ handlers */
+
+void mutex_init(mutex_t *m);
+void mutex_lock(mutex_t *m);
+int mutex_trylock(mutex_t *m);          /* 0 on success, -1 if held */
+void mutex_unlock(mutex_t *m);
+
+/* cond_wait() atomically releases m and sleeps, then re-acquires m before
+   returning. Wakeups may be spurious: re-check the predicate in a loop. */
+void cond_init(condvar_t *cv);
+void cond_wait(condvar_t *cv, mutex_t *m);
+void cond_signal(condvar_t *cv);
+void cond_broadcast(condvar_t *cv);
+
+#endif
@@ -2,9 +2,17 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#ifdef KACCHI_HOST
+/* Host build (make host): use the C library's definitions */
+#include <stdint.h>
+#include <stddef.h>
+#else
+
+typedef unsigned long long uint64_t;
 typedef unsigned int   uint32_t;
 typedef unsigned short uint16_t;
 typedef unsigned char  uint8_t;
+typedef long long          int64_t;
 typedef int            int32_t;
 typedef short          int16_t;
 typedef char           int8_t;
@@ -13,4 +21,6 @@ typedef uint32_t size_t;
 
 #define NULL  ((void*)0)
 
+#endif
+
 #endif
\ No newline at end of file